@@ -43,7 +43,6 @@ int main(){
     double lowestState = 0.701872;
     auto IMHSampler = Markov::IMH(candidate, target, lowestState);
     constexpr std::size_t num_samples = 1.0e6; //take 10,000 samples
-    #pragma omp parallel num_threads(4)
     auto samples = IMHSampler.perfect_IMH_sample_vector(num_samples);
     
     //write to file for plotting with Python and seaborn
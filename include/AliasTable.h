@@ -0,0 +1,41 @@
+#ifndef AliasTable_hpp
+#define AliasTable_hpp
+#include<vector>
+namespace Markov
+{
+    /**
+     * @summary: Walker/Vose alias table for O(1) sampling from a discrete distribution
+     */
+    struct AliasTable
+    {
+        std::vector<double> prob;
+        std::vector<int> alias;
+        
+        AliasTable() {}
+        /**
+         * @param weights: nonnegative weights, need not sum to 1
+         * @param n: number of weights
+         */
+        AliasTable(const double* weights, int n);
+        
+        int size() const noexcept { return static_cast<int>(prob.size()); }
+        
+        /**
+         * @param u: random uniform between 0 and 1. The integer part of u*n picks the
+         * column and the fractional part decides between it and its alias, so only one
+         * uniform is consumed per draw
+         * @return: index drawn with probability proportional to its weight
+         */
+        int sample(double u) const noexcept
+        {
+            int n = static_cast<int>(prob.size());
+            double scaled = u * n;
+            int i = static_cast<int>(scaled);
+            if(i >= n){
+                i = n - 1;
+            }
+            return (scaled - i < prob[i]) ? i : alias[i];
+        }
+    };
+}
+#endif /* AliasTable_hpp */
@@ -0,0 +1,113 @@
+/**
+ * @summary : advances many independent walkers on one transition matrix in lockstep,
+ * using AVX2 / AVX-512 gathers when the CPU has them.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef BatchStepper_h
+#define BatchStepper_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<mkl.h>
+#include<vector>
+#include<cstdint>
+#include"MarkovChain.h"
+#include"RNG.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    /**
+     Every row of the transition matrix is flattened into an alias table (N*N probabilities and
+     N*N int32 aliases), so a step is one uniform, one gather from each table and a blend, with
+     no search. Walker states and the per-walker xoshiro256+ generators are stored
+     structure-of-arrays, so a block of walkers is loaded into registers once and kept
+     there for all the steps.
+
+     The kernel (AVX-512F, 16 walkers per iteration; AVX2, 8; or scalar) is chosen at
+     construction by CPU feature detection. All kernels do the same floating-point operations,
+     so a given seed produces the same paths whichever kernel runs.
+     */
+    class BatchStepper
+    {
+    public:
+        enum Kernel { SCALAR = 0, AVX2 = 1, AVX512 = 2 };
+
+    protected:
+        int numStates = 0;
+        int numWalkers = 0;
+        int paddedWalkers = 0;
+        Kernel kernel = SCALAR;
+        std::vector<double> _prob;
+        std::vector<int32_t> _alias;
+        std::vector<int32_t> _states;
+        //xoshiro256+ state, one 4-word generator per walker, SoA
+        std::vector<uint64_t> _s0, _s1, _s2, _s3;
+
+        void buildTables(const Eigen::MatrixXd& transition);
+        void seed(uint64_t seed);
+
+    public:
+        BatchStepper() {}
+
+        /**
+         * @param transition: N x N transition matrix
+         * @param walkers: number of walkers, all starting in state 0
+         * @param seed: seeds the walkers' generators
+         */
+        BatchStepper(const Eigen::MatrixXd& transition, int walkers, uint64_t seed);
+
+        /**
+         * @summary: as above, with initial states drawn from mc's initial distribution
+         */
+        BatchStepper(const MarkovChain& mc, int walkers, uint64_t seed);
+
+        /**
+         * @summary: as above, seeded by one draw from rng
+         */
+        BatchStepper(const MarkovChain& mc, int walkers, RNG& rng);
+
+        /**
+         * @summary: as above, seeded from the calling thread's default_rng()
+         */
+        BatchStepper(const MarkovChain& mc, int walkers);
+
+        /**
+         * @summary: advances every walker by steps transitions
+         */
+        void step(int steps = 1) noexcept;
+
+        /**
+         * @summary: overrides the detected kernel; throws if the CPU does not support it
+         */
+        void setKernel(Kernel k);
+        Kernel getKernel() const noexcept { return kernel; }
+
+        /**
+         * @return: best kernel this CPU supports
+         */
+        static Kernel detectKernel() noexcept;
+
+        void setStates(const std::vector<int>& states);
+        std::vector<int> getStates() const;
+        /**
+         * @return: pointer to the getNumWalkers() current states
+         */
+        const int32_t* data() const noexcept { return _states.data(); }
+        int getNumWalkers() const noexcept { return numWalkers; }
+        int getNumStates() const noexcept { return numStates; }
+
+        /**
+         * @return: i-th entry is the number of walkers currently in state i
+         */
+        std::vector<int> stateCounts() const;
+    };
+}
+
+#endif
@@ -7,12 +7,22 @@
 #undef Success
 #endif
 #include <Eigen/Core>
+#include<Eigen/Sparse>
 #include<deque>
 #include<valarray>
 #include<random>
 #include<algorithm>
+#include<vector>
+#include<functional>
+#include<utility>
+#include<cstdint>
+#include<chrono>
+#include<limits>
 #include<type_traits>
+#include<optional>
 #include"MarkovChain.h"
+#include"AliasTable.h"
+#include"RNG.h"
 #include<mkl.h>
 #include<complex>
 using namespace std;
@@ -39,45 +49,684 @@ namespace Markov
     double k_stationary_variation_distance(Eigen::MatrixXd trans, int k);
     int mixing_time(const Eigen::MatrixXd &trans);
 
-    int isCoalesced(const Eigen::MatrixXd &mat);
+    /**
+     what one CFTP run cost; filled by the samplers below when given a non-null pointer
+     */
+    struct CFTPStats
+    {
+        int horizon = 0; //horizon (or steps, for the forward samplers) of the run, -1 if it failed
+        long uniforms = 0; //uniforms drawn
+        size_t peakBytes = 0; //working buffers (uniforms, image sets, paths) at their largest
+        double seconds = 0; //wall time
+        std::vector<int> distinctCounts; //size of the image set or bound after each step of the last pass
+    };
+
+    /**
+     aggregate of many CFTPStats, for batch sampling. Histograms are on log2 scales, since
+     coalescence times are heavy-tailed
+     */
+    struct CFTPBatchStats
+    {
+        long samples = 0;
+        long failures = 0;
+        long uniforms = 0;
+        size_t peakBytes = 0; //largest over the runs
+        double seconds = 0; //total wall time of the runs
+        double maxSeconds = 0;
+        int maxHorizon = 0;
+        std::vector<long> horizonHistogram; //[k] = runs with horizon in [2^k, 2^(k+1))
+        std::vector<long> timeHistogram; //[0] = runs under 1 microsecond, [k] = runs in [2^(k-1), 2^k) microseconds
+
+        void add(const CFTPStats& run);
+        /**
+         * @summary: adds other's counts to this; the result does not depend on merge order
+         * (up to rounding of the total time)
+         */
+        void merge(const CFTPBatchStats& other);
+    };
+
+    /**
+     The set of distinct images of the current composite map, i.e. the states the coupled
+     copies currently occupy. A step maps each distinct state once and drops duplicates with
+     a stamp array (stamp[s] == epoch iff s is already in the new set), so merging copies
+     costs nothing extra, coalescence is size() == 1 in O(1), and a step costs O(size())
+     instead of O(n) -- the set usually shrinks fast.
+     */
+    struct ImageSet
+    {
+        std::vector<int> states;
+        std::vector<int> scratch;
+        std::vector<unsigned> stamp;
+        unsigned epoch = 0;
+
+        /**
+         * @summary: every one of the n states is its own image
+         */
+        void reset(int n)
+        {
+            states.resize(n);
+            for(int i = 0; i < n; i++){
+                states[i] = i;
+            }
+            if(static_cast<int>(stamp.size()) != n){
+                stamp.assign(n, 0);
+                epoch = 0;
+            }
+        }
+
+        /**
+         * @param update: int(int), the step's update with its uniform bound in
+         */
+        template<typename Update>
+        void step(Update&& update)
+        {
+            if(++epoch == 0){
+                std::fill(stamp.begin(), stamp.end(), 0);
+                epoch = 1;
+            }
+            scratch.clear();
+            for(auto x : states){
+                int y = update(x);
+                if(stamp[y] != epoch){
+                    stamp[y] = epoch;
+                    scratch.push_back(y);
+                }
+            }
+            states.swap(scratch);
+        }
+
+        int size() const noexcept { return static_cast<int>(states.size()); }
+        bool coalesced() const noexcept { return states.size() == 1; }
+        size_t bytes() const noexcept
+        {
+            return (states.capacity() + scratch.capacity()) * sizeof(int) + stamp.capacity() * sizeof(unsigned);
+        }
+    };
+
+    /**
+     Propp-Wilson coupling from the past. Every state is started at time -T and all of them
+     are driven by the same uniforms U_{-T}, ..., U_{-1}; if they have coalesced by time 0, the
+     common value is an exact sample from the stationary distribution. Otherwise T doubles and
+     the uniforms already drawn for times -1, ..., -T are reused, as the method requires.
+
+     The update is the inverse-CDF map used by random_transition (binary search over the row's
+     cumulative sums), applied to a compact int array of the images of all starting states, so
+     a pass at horizon T costs O(n * T * log n) and the doubling keeps the total within twice
+     the final pass. All buffers are kept between samples, so repeated sampling does not
+     allocate once the horizon stops growing.
+     @source: Propp and Wilson, "Exact sampling with coupled Markov chains and applications to
+     statistical mechanics", Random Structures and Algorithms 9, 1996
+     */
+    class CFTPEngine
+    {
+    protected:
+        int nStates = 0;
+        int maxHorizon = 0;
+        int horizon = 0;
+        std::vector<double> _cdf; //row-major cumulative sums of the transition matrix
+        std::vector<double> _uniforms; //_uniforms[k] drives the step from time -(k+1) to -k
+        ImageSet _images; //distinct states of the copies started at time -T
+        std::vector<int> _distinct; //_distinct[t] = size of the image set after t+1 steps of the last pass
+
+        /**
+         * @summary: runs every state forward from time -T to 0
+         * @return: the common state at time 0, or -1 if the copies have not coalesced
+         */
+        int run(int T) noexcept;
+
+    public:
+        CFTPEngine() {}
+
+        /**
+         * @param mat: N x N transition matrix, of any scalar type
+         * @param maxHorizon: largest T tried before sample gives up
+         */
+        template<typename Derived>
+        explicit CFTPEngine(const Eigen::MatrixBase<Derived>& mat, int maxHorizon = 1 << 20)
+        : nStates(mat.cols()), maxHorizon(maxHorizon), _cdf(static_cast<size_t>(mat.cols()) * mat.cols())
+        {
+            for(int i = 0; i < nStates; i++){
+                double s = 0;
+                for(int j = 0; j < nStates; j++){
+                    s += static_cast<double>(mat(i,j));
+                    _cdf[static_cast<size_t>(i) * nStates + j] = s;
+                }
+            }
+        }
+
+        /**
+         * @param state: current state
+         * @param u: random uniform between 0 and 1
+         * @return: first j with cdf(state, j) >= u, or the last state if rounding leaves the
+         * row sum below u; the same transition random_transition makes
+         */
+        int update(int state, double u) const noexcept
+        {
+            const double* row = _cdf.data() + static_cast<size_t>(state) * nStates;
+            return std::min<int>(std::lower_bound(row, row + nStates, u) - row, nStates - 1);
+        }
+
+        /**
+         * @summary: fills stats, if not null, from the last run, started at start
+         */
+        void report(CFTPStats* stats, std::chrono::steady_clock::time_point start) const;
+
+        /**
+         * @param gen: random engine
+         * @param stats: if not null, filled with the cost of this run
+         * @return: perfect sample from the stationary distribution, or -1 if the chain did not
+         * coalesce within maxHorizon steps
+         */
+        template<typename Engine>
+        int sample(Engine& gen, CFTPStats* stats = nullptr)
+        {
+            auto start = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            uniform_real_distribution<> dis(0.0,1.0);
+            _uniforms.clear();
+            horizon = -1;
+            int s = -1;
+            for(long T = 1; T <= maxHorizon; T *= 2){
+                while(static_cast<long>(_uniforms.size()) < T){
+                    _uniforms.push_back(dis(gen));
+                }
+                s = run(static_cast<int>(T));
+                if(s != -1){
+                    horizon = static_cast<int>(T);
+                    break;
+                }
+            }
+            report(stats, start);
+            return s;
+        }
+
+        /**
+         * @return: horizon T at which the last sample coalesced, -1 if it did not
+         */
+        int getHorizon() const noexcept { return horizon; }
+        int getNumStates() const noexcept { return nStates; }
+
+        /**
+         * @return: P(state, 0) + ... + P(state, j); update(state, u) = j exactly for u in
+         * (cdf(state, j-1), cdf(state, j)]
+         */
+        double cdf(int state, int j) const noexcept { return _cdf[static_cast<size_t>(state) * nStates + j]; }
+
+        /**
+         * @return: number of distinct images after each step of the last pass (from time -T
+         * on), up to the step where they coalesced. Shows how quickly the coupling contracts,
+         * which is what the horizon and block length should be tuned to
+         */
+        const std::vector<int>& getDistinctCounts() const noexcept { return _distinct; }
+    };
+
+    /**
+     Wilson's read-once CFTP. Time is cut into blocks of L steps, each with fresh uniforms, and
+     each block's composite map is computed forward and then forgotten, so memory is O(n)
+     whatever the coalescence time. Between two consecutive coalescent blocks, the state
+     obtained by starting at the value of the first one and running it through the
+     non-coalescent blocks in between is an exact sample, and consecutive samples are
+     independent. One forward run therefore produces a stream of i.i.d. perfect samples,
+     at an expected cost of L / P(block coalesces) steps per sample.
+     @source: Wilson, "How to couple from the past using a read-once source of randomness",
+     Random Structures and Algorithms 16(1), 2000
+     */
+    class ReadOnceCFTP
+    {
+    protected:
+        CFTPEngine _engine; //for its update function
+        int nStates = 0;
+        int blockLength = 0;
+        int pending = -1; //value of the last coalescent block, carried forward
+        ImageSet _images;
+        int blockValue = -1; //constant value of the last block's map, if it coalesced
+        RNG gen;
+        uniform_real_distribution<> dis;
+
+        /**
+         * @summary: runs one block of blockLength fresh steps on every state, and x (if >= 0) with them
+         * @return: true if the block's map is constant
+         */
+        bool block(int& x);
+
+        /**
+         * @summary: picks the smallest power of two L for which at least half of a few trial
+         * blocks coalesce, following Wilson's advice of a coalescence probability around 1/2.
+         * Uses its own uniforms, so the choice of L is independent of the samples
+         */
+        void tuneBlockLength(int maxBlockLength);
+
+    public:
+        ReadOnceCFTP() {}
+
+        /**
+         * @param mat: N x N transition matrix
+         * @param seed: seed for the forward run
+         * @param blockLength: L, or 0 to choose it automatically
+         * @param maxBlockLength: bound for the automatic choice; throws if even this
+         * rarely coalesces
+         */
+        ReadOnceCFTP(const Eigen::MatrixXd& mat, uint64_t seed, int blockLength = 0, int maxBlockLength = 1 << 20);
+
+        /**
+         * @param stats: if not null, filled with the cost of this sample: horizon is the
+         * number of steps run since the previous sample
+         * @return: next perfect sample; samples are i.i.d. from the stationary distribution
+         */
+        int next(CFTPStats* stats = nullptr);
+
+        /**
+         * @param count: number of samples
+         * @return: the next count samples
+         */
+        std::vector<int> next(int count);
+
+        int getBlockLength() const noexcept { return blockLength; }
+    };
+
+    /**
+     Bounding-chain CFTP for large sparse chains (after Huber). Instead of all n copies it
+     tracks a bounding set guaranteed to contain every copy's state, using the same
+     inverse-CDF coupling as CFTPEngine:
+
+     - at time -T the bound is Top, the whole state space, which is never materialized;
+     - the image of Top under a uniform u is the set of columns j with u in the u-interval
+       (cdf(i, j-1), cdf(i, j)] of some row i. The intervals of each column are merged and
+       stored in a centered interval tree, so this is a stabbing query costing
+       O(log nnz + size of the image) instead of a pass over all n rows;
+     - once the bound is an explicit set it is mapped state by state, deduplicated with a
+       bitset of n bits, and it can only shrink. Coalescence is a bound of size 1.
+
+     If the image of Top has more than maxTracked states, the bound stays Top for that step
+     (still a valid superset), so the work per step is at most O(log nnz + maxTracked). The
+     default maxTracked = n never gives up on a step, i.e. falls back to full tracking when
+     the bound is large. Chains with shared targets (resets, hubs, restart states) have small
+     images of Top and coalesce quickly even with 10^6 or more states.
+     @source: Huber, "Perfect sampling using bounding chains", Annals of Applied Probability
+     14(2), 2004
+     */
+    class BoundingChainCFTP
+    {
+    protected:
+        struct IntervalNode
+        {
+            double center;
+            int left, right; //children, -1 if none
+            int begin, end; //range in _byStart and _byEnd of the intervals containing center
+        };
+
+        int nStates = 0;
+        int maxTracked = 0;
+        int maxHorizon = 0;
+        int horizon = 0;
+        //CSR transition matrix with cumulative row sums
+        std::vector<int> _outer;
+        std::vector<int> _col;
+        std::vector<double> _cum;
+        //per-column merged intervals (start, end] and the tree over them
+        std::vector<double> _ivStart, _ivEnd;
+        std::vector<int> _ivCol;
+        std::vector<int> _byStart, _byEnd;
+        std::vector<IntervalNode> _nodes;
+        int root = -1;
+
+        std::vector<double> _uniforms; //_uniforms[k] drives the step from time -(k+1) to -k
+        std::vector<int> _bound, _scratch;
+        std::vector<uint64_t> _bits;
+        std::vector<int> _distinct; //bound size after each step of the last pass, N while it is Top
+
+        int buildTree(std::vector<int>& ids);
+        /**
+         * @summary: fills _bound with the image of Top under u
+         * @return: false if it has more than maxTracked states
+         */
+        bool stab(double u);
+        void mapBound(double u);
+        int run(int T);
+
+    public:
+        BoundingChainCFTP() {}
+
+        /**
+         * @param mat: N x N sparse transition matrix
+         * @param maxTracked: largest explicit bound; 0 means N
+         * @param maxHorizon: largest T tried before sample gives up
+         */
+        BoundingChainCFTP(const Eigen::SparseMatrix<double, Eigen::RowMajor>& mat, int maxTracked = 0, int maxHorizon = 1 << 20);
+
+        /**
+         * @param state: current state
+         * @param u: random uniform between 0 and 1
+         * @return: next state; the same transition CFTPEngine::update makes
+         */
+        int update(int state, double u) const noexcept
+        {
+            const double* begin = _cum.data() + _outer[state];
+            const double* end = _cum.data() + _outer[state+1];
+            int k = std::min<int>(std::lower_bound(begin, end, u) - begin, (end - begin) - 1);
+            return _col[_outer[state] + k];
+        }
+
+        void report(CFTPStats* stats, std::chrono::steady_clock::time_point start) const;
+
+        /**
+         * @param gen: random engine
+         * @param stats: if not null, filled with the cost of this run
+         * @return: perfect sample from the stationary distribution, or -1 if the bound did
+         * not shrink to one state within maxHorizon steps
+         */
+        template<typename Engine>
+        int sample(Engine& gen, CFTPStats* stats = nullptr)
+        {
+            auto start = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            uniform_real_distribution<> dis(0.0,1.0);
+            _uniforms.clear();
+            horizon = -1;
+            int s = -1;
+            for(long T = 1; T <= maxHorizon; T *= 2){
+                while(static_cast<long>(_uniforms.size()) < T){
+                    _uniforms.push_back(dis(gen));
+                }
+                s = run(static_cast<int>(T));
+                if(s != -1){
+                    horizon = static_cast<int>(T);
+                    break;
+                }
+            }
+            report(stats, start);
+            return s;
+        }
+
+        int getHorizon() const noexcept { return horizon; }
+        int getNumStates() const noexcept { return nStates; }
+    };
+
+    /**
+     Fill's interruptible perfect sampler. An attempt with horizon t runs the time reversal
+     P~(i,j) = pi(j) P(j,i) / pi(i) for t steps from a fixed state z, giving a path
+     x_0 <- x_1 <- ... <- x_t = z; draws the forward uniforms conditionally on that path
+     (U_s uniform on the u-interval that CFTPEngine::update maps x_{s-1} to x_s with); and
+     accepts x_0 if the forward maps with those uniforms send every state to z. Failed attempts
+     double t. The accepted value is exactly stationary and independent of how many attempts
+     it took, so stopping on a budget and reporting an abort does not bias the samples that
+     are returned, unlike abandoning a long CFTP run.
+
+     The reversal is sampled with per-row alias tables over its nonzeros, and the stationary
+     vector comes from MarkovChain::stationaryDistribution. Each attempt costs O(t) for the
+     path plus the image-set composition of CFTPEngine.
+     @source: Fill, "An interruptible algorithm for perfect sampling via Markov chains",
+     Annals of Applied Probability 8(1), 1998; Fill, Machida, Murdoch and Rosenthal,
+     "Extension of Fill's perfect rejection sampling algorithm to general chains",
+     Random Structures and Algorithms 17, 2000
+     */
+    class FillSampler
+    {
+    protected:
+        CFTPEngine _engine; //forward update and its CDF
+        int nStates = 0;
+        int z = 0;
+        long stepsUsed = 0;
+        int horizon = 0;
+        std::vector<AliasTable> _reverse;
+        std::vector<std::vector<int> > _reverseTargets;
+        std::vector<int> _path;
+        std::vector<double> _uniforms;
+        ImageSet _images;
+
+        void buildReversal(const Eigen::MatrixXd& P, const Eigen::MatrixXd& pi);
+
+        /**
+         * @summary: one attempt with horizon t; v holds 2t uniforms on [0,1)
+         * @return: the sample, or -1 if the forward maps did not all reach z
+         */
+        int attempt(int t, const double* v);
+
+    public:
+        FillSampler() {}
+
+        /**
+         * @param mc: irreducible chain
+         * @param z: state the reversed path starts from; a state with large stationary mass
+         * makes acceptance likelier
+         */
+        explicit FillSampler(const MarkovChain& mc, int z = 0);
+
+        /**
+         * @param P: N x N transition matrix
+         * @param pi: its 1 x N stationary distribution
+         */
+        FillSampler(const Eigen::MatrixXd& P, const Eigen::MatrixXd& pi, int z = 0);
+
+        /**
+         * @param gen: random engine
+         * @param maxSteps: budget on the total horizon of all attempts; an attempt that would
+         * exceed it is not started
+         * @param maxSeconds: wall-clock budget, checked before each attempt
+         * @param stats: if not null, filled with the cost of this call
+         * @return: perfect sample from the stationary distribution, or -1 if the budget ran out.
+         * Returned samples are unbiased whatever the budget
+         */
+        template<typename Engine>
+        int sample(Engine& gen, long maxSteps, double maxSeconds = std::numeric_limits<double>::infinity(),
+                   CFTPStats* stats = nullptr)
+        {
+            uniform_real_distribution<> dis(0.0,1.0);
+            auto start = std::chrono::steady_clock::now();
+            stepsUsed = 0;
+            horizon = -1;
+            int x = -1;
+            for(long t = 1; ; t *= 2){
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if(stepsUsed + t > maxSteps || elapsed > maxSeconds){
+                    break;
+                }
+                stepsUsed += t;
+                _uniforms.resize(2*t);
+                for(auto& v : _uniforms){
+                    v = dis(gen);
+                }
+                x = attempt(static_cast<int>(t), _uniforms.data());
+                if(x != -1){
+                    horizon = static_cast<int>(t);
+                    break;
+                }
+            }
+            if(stats){
+                stats->horizon = horizon;
+                stats->uniforms = 2*stepsUsed;
+                stats->peakBytes = _uniforms.capacity() * sizeof(double) + _path.capacity() * sizeof(int) + _images.bytes();
+                stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                stats->distinctCounts.clear();
+            }
+            return x;
+        }
+
+        /**
+         * @return: horizon of the accepted attempt of the last call, -1 if it aborted
+         */
+        int getHorizon() const noexcept { return horizon; }
+        /**
+         * @return: total horizon spent by the last call
+         */
+        long getStepsUsed() const noexcept { return stepsUsed; }
+    };
+
+    /**
+     Monotone coupling from the past. If the state space has a partial order with a least
+     element bottom and a greatest element top, and the update preserves it
+     (x <= y implies update(x,u) <= update(y,u) for every u), then every trajectory started at
+     time -T stays between the ones started at bottom and top. Those two meeting by time 0
+     means all of them have, so only two chains are simulated. Each pass costs O(T) calls to
+     update whatever the size of the state space, which is never enumerated.
+     @param State: state type, e.g. an integer queue length or a vector of inventory levels
+     @param Update: callable State(const State&, double u) with u uniform on (0,1), monotone
+     in its first argument
+     @param Compare: strict weak order on State; states are equal when neither is less
+     @source: Propp and Wilson 1996, section 3
+     */
+    template<typename State, typename Update, typename Compare = std::less<State> >
+    class MonotoneCFTP
+    {
+    protected:
+        State _bottom, _top;
+        Update _update;
+        Compare _less;
+        long maxHorizon;
+        long horizon = 0;
+        std::vector<double> _uniforms; //_uniforms[k] drives the step from time -(k+1) to -k
+
+        bool equivalent(const State& a, const State& b) const
+        {
+            return !_less(a,b) && !_less(b,a);
+        }
+
+    public:
+        /**
+         * @param bottom: least state
+         * @param top: greatest state
+         * @param update: monotone update function
+         * @param maxHorizon: largest T tried before sample gives up; the same default as
+         * CFTPEngine, since the uniforms for a failed run are all kept in memory
+         */
+        MonotoneCFTP(const State& bottom, const State& top, Update update, long maxHorizon = 1L << 20, Compare less = Compare())
+        : _bottom(bottom), _top(top), _update(std::move(update)), _less(std::move(less)), maxHorizon(maxHorizon) {}
+
+        /**
+         * @param gen: random engine
+         * @param stats: if not null, filled with the cost of this run (no distinct counts)
+         * @return: perfect sample from the stationary distribution, or nullopt if the top and
+         * bottom chains have not met within maxHorizon steps (the other engines' -1)
+         */
+        template<typename Engine>
+        std::optional<State> sample(Engine& gen, CFTPStats* stats = nullptr)
+        {
+            auto start = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            auto report = [&](){
+                if(stats){
+                    stats->horizon = static_cast<int>(std::min<long>(horizon, std::numeric_limits<int>::max()));
+                    stats->uniforms = _uniforms.size();
+                    stats->peakBytes = _uniforms.capacity() * sizeof(double);
+                    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    stats->distinctCounts.clear();
+                }
+            };
+            uniform_real_distribution<> dis(0.0,1.0);
+            _uniforms.clear();
+            for(long T = 1; T <= maxHorizon; T *= 2){
+                while(static_cast<long>(_uniforms.size()) < T){
+                    _uniforms.push_back(dis(gen));
+                }
+                State hi = _top;
+                State lo = _bottom;
+                long k = T-1;
+                for(; k >= 0; k--){
+                    hi = _update(hi, _uniforms[k]);
+                    lo = _update(lo, _uniforms[k]);
+                    if(equivalent(hi, lo)){
+                        k--;
+                        break;
+                    }
+                }
+                if(equivalent(hi, lo)){
+                    //one trajectory left; finish it to time 0
+                    for(; k >= 0; k--){
+                        hi = _update(hi, _uniforms[k]);
+                    }
+                    horizon = T;
+                    report();
+                    return hi;
+                }
+            }
+            horizon = -1;
+            report();
+            return std::nullopt;
+        }
+
+        /**
+         * @return: horizon T at which the last sample coalesced, -1 if it did not
+         */
+        long getHorizon() const noexcept { return horizon; }
+    };
+
+    /**
+     * @summary: helper so the template arguments are deduced, e.g.
+     * auto cftp = make_monotone_CFTP(0L, capacity, [&](long q, double u){ ... });
+     */
+    template<typename State, typename Update, typename Compare = std::less<State> >
+    MonotoneCFTP<State, Update, Compare> make_monotone_CFTP(const State& bottom, const State& top, Update update,
+                                                            long maxHorizon = 1L << 20, Compare less = Compare())
+    {
+        return MonotoneCFTP<State, Update, Compare>(bottom, top, std::move(update), maxHorizon, std::move(less));
+    }
+
+    /**
+     * @summary: is the inverse-CDF update used by CFTPEngine monotone in the state index? True
+     * when the rows are stochastically increasing, i.e. cdf(i, j) >= cdf(i+1, j) for all i, j
+     * @param mat: N x N transition matrix
+     * @param tol: allowed rounding slack
+     */
+    bool is_stochastically_monotone(const Eigen::MatrixXd &mat, double tol = 1.0e-12);
+
+    /**
+     * @summary: monotone CFTP on an explicit transition matrix whose rows are stochastically
+     * increasing (see is_stochastically_monotone), tracking only states 0 and N-1
+     * @param mat: N x N transition matrix
+     * @param rng: random engine, the calling thread's default_rng() if not given
+     * @return: perfect sample from matrix's distribution, or -1 if the chain did not coalesce
+     */
+    int monotone_CFTP(const Eigen::MatrixXd &mat, RNG& rng);
+    int monotone_CFTP(const Eigen::MatrixXd &mat);
 
     /**
      * @author: Zane Jakobs
      * @summary: voter CFTP algorithm to perfectly sample from the Markov chain with transition matrix mat. Algorithm from https://pdfs.semanticscholar.org/ef02/fd2d2b4d0a914eba5e4270be4161bcae8f81.pdf
-     * @return: perfect sample from matrix's distribution
+     * @param Scalar: float or double, the scalar type of the transition matrix
+     * @param rng: random engine, the calling thread's default_rng() if not given
+     * @return: perfect sample from matrix's distribution, or -1 if the chain did not coalesce
      */
-    int voter_CFTP(const Eigen::MatrixXd &mat);
-
-    /**
-     *@author: Zane Jakobs
-     * @param trans: transition matrix
-     * @param gen, dis: random number generator stuff
-     * @param mat: transition matrix
-     * @param R: deque to hold random numbers
-     * @param M: matrix to represent voter CFTP process
-     * @param nStates: how many states?
-     * @param coalesced: has the chain coalesced?
-     * @return: distribution
-     */
-    int iteratedVoterCFTP( std::mt19937 &gen, std::uniform_real_distribution<> &dis,
-                          const Eigen::MatrixXd &mat, std::deque<double> &R,
-                          Eigen::MatrixXd &M, Eigen::MatrixXd &temp,
-                          int &nStates, bool coalesced);
+    template<typename Scalar>
+    int voter_CFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, RNG& rng);
+    template<typename Scalar>
+    int voter_CFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat);
+
     /**
      * @author: Zane Jakobs
      * @param mat: matrix to sample from
     * @param n: how many samples
-     * @return: vector where i-th entry is the number of times state i appeared
+     * @return: vector where i-th entry is the number of times state i appeared. Throws if any
+     * run fails to coalesce, since leaving it out would bias the counts
+     */
+    template<typename Scalar>
+    valarray<int> sampleVoterCFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, int n);
+
+    /**
+     * @summary: multi-threaded version of the above. Samples are split into fixed blocks,
+     * handed out to threads dynamically since coalescence times vary a lot, and block b
+     * always draws from the stream RNG(seed, b), so each sample does not depend on
+     * which thread ran it. Per-thread integer histograms are summed at the end, so the
+     * counts for a given seed are the same for any number of threads
+     * @param mat: matrix to sample from
+     * @param n: how many samples
+     * @param seed: seed for the per-block streams
+     * @param numThreads: number of threads, 0 for the OpenMP default
+     * @param stats: if not null, the runs' statistics are added to it, failed runs included
+     * @return: vector where i-th entry is the number of times state i appeared; throws, as
+     * above, if any run fails to coalesce
      */
-    valarray<int> sampleVoterCFTP(const Eigen::MatrixXd &mat, int n);
+    template<typename Scalar>
+    valarray<int> sampleVoterCFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, int n,
+                                  uint64_t seed, int numThreads = 0, CFTPBatchStats* stats = nullptr);
 
     /**
      * @author: Zane Jakobs
      * @param mat: matrix to sample from
      * @param n: how many samples
-     * @return: VectorXd where i-th entry is the density of state i
+     * @param stats: if not null, the runs' statistics are added to it
+     * @return: VectorXd where i-th entry is the density of state i; throws if any run fails
+     * to coalesce
     */
-    Eigen::VectorXd voterCFTPDistribution(Eigen::MatrixXd &mat, int n);
+    template<typename Scalar>
+    Eigen::VectorXd voterCFTPDistribution(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, int n,
+                                          CFTPBatchStats* stats = nullptr);
 }
 
 
@@ -0,0 +1,145 @@
+/**
+ * @summary : implementation of a continuous-time Markov chain, given by its generator matrix.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef ContinuousMarkovChain_h
+#define ContinuousMarkovChain_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/Sparse>
+#include<mkl.h>
+#include<vector>
+#include<random>
+#include"MarkovFunctions.h"
+#include"MarkovChain.h"
+#include"RNG.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    /**
+     sample path of a continuous-time chain: the chain enters states[i] at times[i]
+     */
+    typedef struct
+    {
+        std::vector<double> times;
+        std::vector<int> states;
+    }CTMCPath;
+
+class ContinuousMarkovChain
+{
+
+protected:
+    unsigned numStates;
+    //row-major so that row i is contiguous for the jump tables and vector-matrix products
+    Eigen::SparseMatrix<double, Eigen::RowMajor> _generator;
+    Eigen::MatrixXd _initial;
+
+    //Gillespie tables: exit rate of each state, and an alias table over its off-diagonal rates
+    std::vector<double> _exitRates;
+    std::vector<AliasTable> _jumpTables;
+    std::vector<std::vector<int> > _jumpTargets;
+
+    void buildJumpTables();
+
+    //the Gillespie loop behind both simulate overloads; only instantiated in the .cpp
+    template<typename Engine>
+    CTMCPath simulatePath(double tEnd, Engine& gen) const;
+
+public:
+
+    ContinuousMarkovChain() {}
+
+    /**
+     * @param generator: N x N generator matrix. Off-diagonal entries are rates, rows sum to 0
+     * @param initial: 1 x N initial probability row vector
+     */
+    ContinuousMarkovChain(const Eigen::MatrixXd& generator, const Eigen::MatrixXd& initial);
+    ContinuousMarkovChain(const Eigen::SparseMatrix<double>& generator, const Eigen::MatrixXd& initial);
+
+    void setGenerator(const Eigen::MatrixXd& generator);
+    void setGenerator(const Eigen::SparseMatrix<double>& generator);
+    void setInitial(const Eigen::MatrixXd& initial);
+
+    Eigen::MatrixXd getGenerator() const;
+    const Eigen::SparseMatrix<double, Eigen::RowMajor>& getSparseGenerator() const;
+    Eigen::MatrixXd getInit() const;
+    int getNumStates() const;
+
+    /**
+     * @return: max_i |Q(i,i)|, the smallest valid uniformization rate
+     */
+    double uniformizationRate() const;
+
+    /**
+     * @param rate: uniformization rate, at least uniformizationRate()
+     * @return: discrete chain with transition matrix I + Q/rate and the same initial distribution
+     */
+    MarkovChain uniformizedChain(double rate) const;
+
+    /**
+     * @return: jump chain, P(i,j) = Q(i,j)/|Q(i,i)| for i != j. Absorbing states get P(i,i) = 1
+     */
+    MarkovChain embeddedChain() const;
+
+    /**
+     * @summary: solves pi * Q = 0, sum(pi) = 1 with the same solver MarkovChain uses
+     * @return: 1 x N stationary distribution
+     */
+    Eigen::MatrixXd stationaryDistribution() const;
+
+    /**
+     * @name ContinuousMarkovChain::transientDistribution
+     * @summary: distribution at time t by uniformization, with the Poisson weights
+     * truncated Fox-Glynn style so that the neglected mass is below eps
+     * @param t: time
+     * @param eps: truncation error bound
+     * @return: 1 x N row vector, _initial * exp(Q t)
+     */
+    Eigen::MatrixXd transientDistribution(double t, double eps = 1.0e-10) const;
+
+    /**
+     * @name ContinuousMarkovChain::transientDistributionKrylov
+     * @summary: distribution at time t via a Krylov (Arnoldi) approximation of exp(Q^T t) * pi0^T.
+     * Stiff chains, where uniformization would need a huge number of Poisson terms, are
+     * better served by this
+     * @param t: time
+     * @param m: dimension of the Krylov subspace
+     * @param tol: local error tolerance per time step
+     * @return: 1 x N row vector, _initial * exp(Q t). Throws if a step cannot meet tol even
+     * after 60 halvings
+     */
+    Eigen::MatrixXd transientDistributionKrylov(double t, int m = 30, double tol = 1.0e-10) const;
+
+    /**
+     * @name ContinuousMarkovChain::simulate
+     * @summary: Gillespie simulation of a sample path on [0, tEnd]. Jump targets are drawn
+     * from per-state alias tables, so each jump costs O(1) regardless of the number of states
+     * @param tEnd: time horizon
+     * @param gen: random engine
+     * @return: jump times and the states entered at those times
+     */
+    CTMCPath simulate(double tEnd, std::mt19937& gen) const;
+    CTMCPath simulate(double tEnd, RNG& gen) const;
+    //draws from the calling thread's default_rng()
+    CTMCPath simulate(double tEnd) const;
+};
+
+    /**
+     * @summary: Fox-Glynn style truncation of the Poisson(lambda) weights
+     * @param lambda: Poisson rate
+     * @param eps: bound on the neglected mass
+     * @param left: first index kept
+     * @return: normalized weights for left, left+1, ..., left + size - 1
+     */
+    std::vector<double> poisson_weights(double lambda, double eps, int& left);
+}
+
+#endif
@@ -1,6 +1,17 @@
 
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
 #ifndef Distributions_hpp
 #define Distributions_hpp
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/Cholesky>
 #include<utility>
 #include<array>
 #include<vector>
@@ -8,6 +19,8 @@
 #include<array>
 #include<gsl/gsl_cdf.h>
 #include<type_traits>
+#include<cmath>
+#include"RNG.h"
 /**
  NOTE FROM AUTHOR (ZANE JAKOBS):
  ONLY KEEP #include<optional> IF YOU ARE COMPILING WITH C++17 OR LATER
@@ -28,6 +41,12 @@ namespace Markov {
      */
     pair<default_random_engine, uniform_real_distribution<double> > std_sampler_pair() noexcept;
     
+    /**
+     *@brief: as above, with the engine seeded by one draw from rng instead of the calling
+     * thread's default_rng()
+     */
+    pair<default_random_engine, uniform_real_distribution<double> > std_sampler_pair(RNG& rng) noexcept;
+    
     
     double uniform_sample(pair<default_random_engine, uniform_real_distribution<double> >& spair) noexcept;
     /**
@@ -105,11 +124,20 @@ namespace Markov {
         
         //let X ~ \Lambda(k). This function returns P(X = x)
         constexpr double P_eq(const int& x) noexcept;
+        //returns log P(X = x)
+        double logpdf(const int& x) const noexcept;
         //returns P( X <= x)
         constexpr double cdf(const int& x) noexcept;
-        //generates a sample
+        //generates a sample from the calling thread's default_rng()
         int sample() noexcept;
         
+        template<typename Engine>
+        int sample(Engine& gen) const noexcept
+        {
+            poisson_distribution<int> dis(lambda);
+            return dis(gen);
+        }
+        
     };
     
     class Exponential
@@ -130,6 +158,8 @@ namespace Markov {
         //pdf at a point
         double pdf(double x) noexcept;
         
+        double logpdf(double x) const noexcept;
+        
         double cdf(double x) noexcept;
         
         constexpr double mean() noexcept;
@@ -137,6 +167,13 @@ namespace Markov {
         constexpr double variance() noexcept;
         
         double sample() noexcept;
+        
+        template<typename Engine>
+        double sample(Engine& gen) const noexcept
+        {
+            exponential_distribution<double> dis(lambda);
+            return dis(gen);
+        }
     };
     
     class Normal
@@ -152,7 +189,7 @@ namespace Markov {
             sigma = s;
         }
         //sqrt(2*pi)
-        const double sroot2pi = 1.772453851;
+        const double sroot2pi = 2.506628275;
     
         constexpr void setMu(double _mu) noexcept;
         
@@ -160,12 +197,21 @@ namespace Markov {
         
         double pdf(double x) const noexcept;
         
+        double logpdf(double x) const noexcept;
+        
         constexpr double mean() const noexcept;
         
         constexpr double variance() const noexcept;
         
         double sample() const noexcept;
         
+        template<typename Engine>
+        double sample(Engine& gen) const noexcept
+        {
+            normal_distribution<double> dis(mu,sigma);
+            return dis(gen);
+        }
+        
         /**
          *@author: Zane Jakobs
          *@return: vector of samples from a normal distribution
@@ -178,6 +224,28 @@ namespace Markov {
          *@brief: vector with additions many new samples from a Normal(mu,sigma) distribution.
          */
         void update_sample_vector(vector<double>& sample_seq, unsigned additions) const noexcept;
+
+        /**
+         *@brief: as above, drawing from gen instead of the calling thread's default_rng(), so
+         * callers can give each thread its own reproducible stream
+         */
+        template<typename Engine>
+        vector<double> create_sample_vector(unsigned length, Engine& gen) const noexcept
+        {
+            vector<double> vec;
+            vec.reserve(length);
+            update_sample_vector(vec, length, gen);
+            return vec;
+        }
+
+        template<typename Engine>
+        void update_sample_vector(vector<double>& sample_seq, unsigned additions, Engine& gen) const noexcept
+        {
+            normal_distribution<double> dis(mu,sigma);
+            for(unsigned i = 0; i < additions; i++){
+                sample_seq.push_back(dis(gen));
+            }
+        }
     };
     
     class Gamma
@@ -202,12 +270,20 @@ namespace Markov {
         
         const double pdf(double x) const noexcept;
         
+        double logpdf(double x) const noexcept;
+        
         constexpr double mean() noexcept;
         
         constexpr double variance() noexcept;
         
         double sample() noexcept;
-
+        
+        template<typename Engine>
+        double sample(Engine& gen) const noexcept
+        {
+            gamma_distribution<double> dis(alpha,beta);
+            return dis(gen);
+        }
     };
     
     
@@ -266,6 +342,8 @@ namespace Markov {
         double fast_std_pdf(double x) const noexcept;
         //NOT THE ACTUAL PDF. it is proportional to it though.
         double pdf(double x) const noexcept;
+        //log of pdf above, computed with log1p instead of pow
+        double logpdf(double x) const noexcept;
         
         double cdf(double x) const noexcept;
         
@@ -307,8 +385,21 @@ namespace Markov {
             return 1.0/(M_PI*sigma* (1+adjX*adjX));
         }
         
+        double logpdf(double x) const noexcept
+        {
+            double adjX = (x-mu)/sigma;
+            return -std::log(M_PI*sigma) - std::log1p(adjX*adjX);
+        }
+        
         double sample() const noexcept;
         
+        template<typename Engine>
+        double sample(Engine& gen) const noexcept
+        {
+            cauchy_distribution<double> dis(mu,sigma);
+            return abv ? abs(dis(gen)) : dis(gen);
+        }
+        
         /**
          *@author: Zane Jakobs
          *@return: vector of samples from a Cauchy distribution
@@ -321,9 +412,228 @@ namespace Markov {
          *@brief: vector with additions many new samples from a Cauchy(mu,sigma) distribution.
          */
         void update_sample_vector(vector<double>& sample_seq, unsigned additions) const noexcept;
+
+        /**
+         *@brief: as above, drawing from gen instead of the calling thread's default_rng(), so
+         * callers can give each thread its own reproducible stream
+         */
+        template<typename Engine>
+        vector<double> create_sample_vector(unsigned length, Engine& gen) const noexcept
+        {
+            vector<double> vec;
+            vec.reserve(length);
+            update_sample_vector(vec, length, gen);
+            return vec;
+        }
+
+        template<typename Engine>
+        void update_sample_vector(vector<double>& sample_seq, unsigned additions, Engine& gen) const noexcept
+        {
+            cauchy_distribution<double> dis(mu,sigma);
+            for(unsigned i = 0; i < additions; i++){
+                sample_seq.push_back(abv ? abs(dis(gen)) : dis(gen));
+            }
+        }
     };
     
     
+    /**
+     *@brief: X = X * L^T in place, for lower triangular L. Column j of the product reads only
+     * columns 0..j of X, so filling the columns right to left needs no temporary
+     */
+    inline void multiply_lower_transpose_in_place(Eigen::Ref<Eigen::MatrixXd> X, const Eigen::MatrixXd& L) noexcept
+    {
+        for(int j = X.cols() - 1; j >= 0; j--){
+            X.col(j) *= L(j,j);
+            if(j > 0){
+                X.col(j).noalias() += X.leftCols(j) * L.row(j).head(j).transpose();
+            }
+        }
+    }
+    
+    /**
+     *@brief: multivariate normal N(mu, Sigma) over Eigen vectors. The block functions take
+     * one point per row of a column-major matrix, so each coordinate of a block is contiguous
+     * and a whole block is whitened with one triangular solve
+     */
+    class MultivariateNormal
+    {
+    protected:
+        Eigen::VectorXd mu;
+        Eigen::MatrixXd L; //lower Cholesky factor of Sigma
+        double log_norm = 0.0; //-d/2 log(2 pi) - log det L
+    public:
+        /**
+         *@param m: mean
+         *@param Sigma: covariance; throws if it is not positive definite
+         */
+        MultivariateNormal(const Eigen::VectorXd& m, const Eigen::MatrixXd& Sigma);
+        
+        int dim() const noexcept { return mu.size(); }
+        const Eigen::VectorXd& mean() const noexcept { return mu; }
+        Eigen::MatrixXd variance() const { return L*L.transpose(); }
+        
+        double logpdf(const Eigen::Ref<const Eigen::VectorXd>& x) const noexcept;
+        double pdf(const Eigen::Ref<const Eigen::VectorXd>& x) const noexcept { return std::exp(logpdf(x)); }
+        
+        /**
+         *@param X: points, one per row
+         *@param out: out[i] = logpdf(X.row(i))
+         */
+        void logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out) const;
+        
+        /**
+         *@brief: as above, solving in place in work, which only grows; a caller that keeps
+         * work between calls makes scoring allocation-free
+         */
+        void logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, Eigen::MatrixXd& work) const;
+        
+        template<typename Engine>
+        Eigen::VectorXd sample(Engine& gen) const
+        {
+            Eigen::MatrixXd X(1, dim());
+            sample_block(X, gen);
+            return X.row(0).transpose();
+        }
+        
+        /**
+         *@brief: fills every row of X with an independent draw. Row i uses the same numbers
+         * from gen as the i-th of a run of sample() calls would
+         */
+        template<typename Engine>
+        void sample_block(Eigen::Ref<Eigen::MatrixXd> X, Engine& gen) const
+        {
+            normal_distribution<double> dis(0.0,1.0);
+            for(int i = 0; i < X.rows(); i++){
+                for(int j = 0; j < X.cols(); j++){
+                    X(i,j) = dis(gen);
+                }
+            }
+            multiply_lower_transpose_in_place(X, L);
+            X.rowwise() += mu.transpose();
+        }
+    };
+    
+    /**
+     *@brief: multivariate Student t with nu degrees of freedom, location mu and scale
+     * matrix Sigma; a heavy-tailed candidate for multivariate perfect IMH, where the
+     * candidate's tails must dominate the target's. Same block layout as MultivariateNormal
+     */
+    class MultivariateStudentT
+    {
+    protected:
+        Eigen::VectorXd mu;
+        Eigen::MatrixXd L; //lower Cholesky factor of Sigma
+        double nu = 1.0;
+        double log_norm = 0.0;
+    public:
+        MultivariateStudentT(const Eigen::VectorXd& m, const Eigen::MatrixXd& Sigma, double _nu);
+        
+        int dim() const noexcept { return mu.size(); }
+        const Eigen::VectorXd& getLocation() const noexcept { return mu; }
+        double getNu() const noexcept { return nu; }
+        
+        double logpdf(const Eigen::Ref<const Eigen::VectorXd>& x) const noexcept;
+        double pdf(const Eigen::Ref<const Eigen::VectorXd>& x) const noexcept { return std::exp(logpdf(x)); }
+        void logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out) const;
+        void logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, Eigen::MatrixXd& work) const;
+        
+        template<typename Engine>
+        Eigen::VectorXd sample(Engine& gen) const
+        {
+            Eigen::MatrixXd X(1, dim());
+            sample_block(X, gen);
+            return X.row(0).transpose();
+        }
+        
+        //x = mu + L z / sqrt(g / nu), z ~ N(0, I), g ~ chi^2_nu
+        template<typename Engine>
+        void sample_block(Eigen::Ref<Eigen::MatrixXd> X, Engine& gen) const
+        {
+            normal_distribution<double> dis(0.0,1.0);
+            gamma_distribution<double> chi2(0.5*nu, 2.0);
+            for(int i = 0; i < X.rows(); i++){
+                for(int j = 0; j < X.cols(); j++){
+                    X(i,j) = dis(gen);
+                }
+                X.row(i) /= std::sqrt(chi2(gen)/nu);
+            }
+            multiply_lower_transpose_in_place(X, L);
+            X.rowwise() += mu.transpose();
+        }
+    };
+    
+    //used when Dist has a logpdf member
+    template<typename Dist, typename Point>
+    auto log_density_impl(const Dist& dist, const Point& x, int) noexcept -> decltype(dist.logpdf(x))
+    {
+        return dist.logpdf(x);
+    }
+    
+    template<typename Dist, typename Point>
+    double log_density_impl(const Dist& dist, const Point& x, long) noexcept
+    {
+        return std::log(dist.pdf(x));
+    }
+    
+    /**
+     *@return: log of dist's density at x: dist.logpdf(x) if the class has one, otherwise
+     * log(dist.pdf(x)), so targets that only define pdf still work in log-domain code
+     */
+    template<typename Dist, typename Point>
+    double log_density(const Dist& dist, const Point& x) noexcept
+    {
+        return log_density_impl(dist, x, 0);
+    }
+    
+    //used when Dist has a logpdf_block member
+    template<typename Dist>
+    auto log_density_block_impl(const Dist& dist, const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, int) -> decltype(dist.logpdf_block(X, out))
+    {
+        return dist.logpdf_block(X, out);
+    }
+    
+    template<typename Dist>
+    void log_density_block_impl(const Dist& dist, const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, long)
+    {
+        Eigen::VectorXd x(X.cols());
+        for(int i = 0; i < X.rows(); i++){
+            x = X.row(i).transpose();
+            out[i] = log_density(dist, x);
+        }
+    }
+    
+    /**
+     *@brief: out[i] = log density of dist at row i of X, through dist.logpdf_block if the
+     * class has one and point by point otherwise
+     */
+    template<typename Dist>
+    void log_density_block(const Dist& dist, const Eigen::Ref<const Eigen::MatrixXd>& X, double* out)
+    {
+        log_density_block_impl(dist, X, out, 0);
+    }
+    
+    //used when Dist's logpdf_block takes a workspace
+    template<typename Dist>
+    auto log_density_block_impl(const Dist& dist, const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, Eigen::MatrixXd& work, int) -> decltype(dist.logpdf_block(X, out, work))
+    {
+        return dist.logpdf_block(X, out, work);
+    }
+    
+    template<typename Dist>
+    void log_density_block_impl(const Dist& dist, const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, Eigen::MatrixXd&, long)
+    {
+        log_density_block(dist, X, out);
+    }
+    
+    /**
+     *@brief: as above, passing work to logpdf_block when the class takes a workspace
+     */
+    template<typename Dist>
+    void log_density_block(const Dist& dist, const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, Eigen::MatrixXd& work)
+    {
+        log_density_block_impl(dist, X, out, work, 0);
+    }
 }
 
 #endif /* Distributions_hpp */
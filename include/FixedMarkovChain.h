@@ -0,0 +1,248 @@
+/**
+ * @summary : Markov chain with a compile-time number of states, for the many small
+ * (3-16 state) chains where heap-allocated MatrixXd and the generic random_transition
+ * loop dominate the cost of simulation.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef FixedMarkovChain_h
+#define FixedMarkovChain_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/QR>
+#include<mkl.h>
+#include<vector>
+#include<random>
+#include"MarkovChain.h"
+#include"RNG.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    /**
+     N is the number of states. Everything lives in fixed-size Eigen objects, so the chain
+     never allocates and the compiler fully unrolls the per-step work. The API mirrors
+     MarkovChain; use toMarkovChain() for anything not provided here.
+     */
+    template<int N>
+    class FixedMarkovChain
+    {
+        static_assert(N > 0, "FixedMarkovChain needs at least one state");
+
+    public:
+        typedef Eigen::Matrix<double, N, N> MatrixType;
+        typedef Eigen::Matrix<double, 1, N> RowVectorType;
+
+    protected:
+        MatrixType _transition;
+        RowVectorType _initial;
+        /*
+         row i holds the cumulative sums of row i of _transition, and row N the cumulative
+         initial distribution. Row-major so each CDF is contiguous for the vector compare
+         */
+        Eigen::Matrix<double, N+1, N, Eigen::RowMajor> _cdf;
+
+        void buildCDF() noexcept
+        {
+            for(int i = 0; i < N; i++){
+                double s = 0;
+                for(int j = 0; j < N; j++){
+                    s += _transition(i,j);
+                    _cdf(i,j) = s;
+                }
+            }
+            double s = 0;
+            for(int j = 0; j < N; j++){
+                s += _initial(j);
+                _cdf(N,j) = s;
+            }
+        }
+
+        /**
+         * @param row: row of _cdf to search
+         * @param u: random uniform between 0 and 1
+         * @return: number of j < N-1 with cdf(row, j) < u, i.e. the sampled column. There is
+         * no data-dependent branch, and for fixed N the loop becomes a few packed compares
+         * and adds. Skipping the last column keeps the result < N even if the row sums to
+         * slightly less than u after rounding
+         */
+        int search(int row, double u) const noexcept
+        {
+            const double* cdf = _cdf.data() + row * N;
+            int next = 0;
+            for(int j = 0; j < N-1; j++){
+                next += (cdf[j] < u);
+            }
+            return next;
+        }
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        FixedMarkovChain() {}
+
+        /**
+         * @param transition: N x N transition matrix
+         * @param initial: 1 x N initial distribution
+         */
+        FixedMarkovChain(const MatrixType& transition, const RowVectorType& initial)
+        {
+            setModel(transition, initial);
+        }
+
+        /**
+         * @summary: copies a dynamically sized chain; throws if it does not have N states
+         */
+        explicit FixedMarkovChain(const MarkovChain& mc)
+        {
+            if(mc.getNumStates() != N){
+                throw "Error: FixedMarkovChain size does not match the number of states.";
+            }
+            Eigen::MatrixXd init = mc.getInit();
+            RowVectorType initial = RowVectorType::Constant(1.0/N);
+            if(init.size()){
+                initial = init.row(0);
+            }
+            setModel(mc.getTransition(), initial);
+        }
+
+        void setModel(const MatrixType& transition, const RowVectorType& initial) noexcept
+        {
+            _transition = transition;
+            _initial = initial;
+            buildCDF();
+        }
+        void setTransition(const MatrixType& transition) noexcept
+        {
+            _transition = transition;
+            buildCDF();
+        }
+        void setInitial(const RowVectorType& initial) noexcept
+        {
+            _initial = initial;
+            buildCDF();
+        }
+
+        const MatrixType& getTransition() const noexcept { return _transition; }
+        const RowVectorType& getInit() const noexcept { return _initial; }
+        constexpr int getNumStates() const noexcept { return N; }
+
+        MarkovChain toMarkovChain() const
+        {
+            return MarkovChain(Eigen::MatrixXd(_transition), Eigen::MatrixXd(_initial), N);
+        }
+
+        /**
+         * @param state: current state
+         * @param u: random uniform between 0 and 1
+         * @return: next state
+         */
+        int step(int state, double u) const noexcept { return search(state, u); }
+
+        /**
+         * @param u: random uniform between 0 and 1
+         * @return: state drawn from the initial distribution
+         */
+        int initialState(double u) const noexcept { return search(N, u); }
+
+        /**
+         * @name FixedMarkovChain::generateSequence
+         * @param n: length of sequence
+         * @param gen: random engine
+         * @return: vector of ints representing the sequence
+         */
+        template<typename Engine>
+        vector<int> generateSequence(int n, Engine& gen) const
+        {
+            std::vector<int> sequence(n > 0 ? n : 0);
+            if(n < 1){
+                return sequence;
+            }
+            uniform_real_distribution<> dis(0.0,1.0);
+            int id = initialState(dis(gen));
+            sequence[0] = id;
+            for(int i = 1; i < n; i++){
+                id = step(id, dis(gen));
+                sequence[i] = id;
+            }
+            return sequence;
+        }
+
+        vector<int> generateSequence(int n) const
+        {
+            return generateSequence(n, default_rng());
+        }
+
+        /**
+         * @name FixedMarkovChain::stationaryDistribution
+         * @summary: solves pi * P = pi, sum(pi) = 1, replacing the last equation of
+         * (P - I)^T pi^T = 0 by the normalization. Assumes the chain is irreducible
+         * @return: 1 x N stationary distribution
+         */
+        RowVectorType stationaryDistribution() const
+        {
+            MatrixType A = (_transition - MatrixType::Identity()).transpose();
+            A.row(N-1).setOnes();
+            Eigen::Matrix<double, N, 1> b = Eigen::Matrix<double, N, 1>::Zero();
+            b(N-1) = 1.0;
+            Eigen::ColPivHouseholderQR<MatrixType> CPH(A);
+            return CPH.solve(b).transpose();
+        }
+
+        /**
+         * @name FixedMarkovChain::distributionAt
+         * @param t: time
+         * @return: _initial * _transition^t
+         */
+        RowVectorType distributionAt(int t) const noexcept
+        {
+            RowVectorType cur = _initial;
+            for(int k = 0; k < t; k++){
+                cur = cur * _transition;
+            }
+            return cur;
+        }
+
+        /**
+         * @name FixedMarkovChain::expectedHittingTimes
+         * @summary: u_i = E[T | X_0 = i] with T = min n >= 0 s.t. X_n = sh solves
+         * (P - I) u = -1 off row sh, with u_sh = 0; see MarkovChain::expectedHittingTime
+         * @param sh: target state
+         * @return: expected hitting time of sh from every state
+         */
+        Eigen::Matrix<double, N, 1> expectedHittingTimes(int sh) const
+        {
+            MatrixType A = _transition - MatrixType::Identity();
+            Eigen::Matrix<double, N, 1> c = Eigen::Matrix<double, N, 1>::Constant(-1.0);
+            A.row(sh).setZero();
+            A(sh,sh) = 1.0;
+            c(sh) = 0.0;
+            Eigen::ColPivHouseholderQR<MatrixType> CPH(A);
+            return CPH.solve(c);
+        }
+
+        /**
+         * @param s0: initial state
+         * @param sh: target state
+         * @return: expected value of (T = min n >= 0 s.t. X_n = sh) | X_0 = s0
+         */
+        double expectedHittingTime(int s0, int sh) const
+        {
+            return expectedHittingTimes(sh)(s0);
+        }
+    };
+
+    typedef FixedMarkovChain<2> MarkovChain2;
+    typedef FixedMarkovChain<3> MarkovChain3;
+    typedef FixedMarkovChain<4> MarkovChain4;
+    typedef FixedMarkovChain<8> MarkovChain8;
+    typedef FixedMarkovChain<16> MarkovChain16;
+}
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @summary : exact (ordinary) lumping of Markov chains by partition refinement.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef Lumping_h
+#define Lumping_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/Sparse>
+#include<mkl.h>
+#include<vector>
+#include"MarkovChain.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    /**
+     quotient chain plus the maps between original states and blocks
+     */
+    typedef struct
+    {
+        MarkovChain quotient;
+        std::vector<int> blockOf; //blockOf[s] = block containing state s
+        std::vector<std::vector<int> > blocks; //blocks[b] = states in block b
+    }LumpedChain;
+
+    /**
+     * @summary: computes the coarsest ordinarily lumpable partition refining initialPartition,
+     * i.e. the coarsest partition such that for all blocks B, C and states s, s' in B,
+     * sum_{t in C} P(s,t) = sum_{t in C} P(s',t). Splitters are processed from a worklist and
+     * only the smaller pieces of a split block are re-queued, as in Paige-Tarjan and
+     * Derisavi-Hermanns-Sanders, so the work is O(nnz * log n) up to the sorting of weights
+     * @param P: N x N transition matrix, column-major so that columns give predecessor lists
+     * @param initialPartition: initialPartition[s] = label of state s. States with different
+     * labels are never merged, so labels encode whatever must be preserved (rewards,
+     * observations, a target state for hitting times). Empty means all states start together
+     * @param tol: weights closer than tol are treated as equal
+     * @return: block index of each state
+     */
+    std::vector<int> coarsest_lumpable_partition(const Eigen::SparseMatrix<double>& P, const std::vector<int>& initialPartition, double tol = 1.0e-12);
+
+    /**
+     * @summary: lumps mc with respect to initialPartition, see above
+     * @return: quotient chain, whose initial distribution is mc's initial distribution
+     * summed over blocks, and the state <-> block maps
+     */
+    LumpedChain lump(const MarkovChain& mc, const std::vector<int>& initialPartition, double tol = 1.0e-12);
+
+    /**
+     * @param lc: lumped chain
+     * @param dist: 1 x N distribution on the original states
+     * @return: 1 x (number of blocks) distribution, summed over each block
+     */
+    Eigen::MatrixXd lump_distribution(const LumpedChain& lc, const Eigen::MatrixXd& dist);
+
+    /**
+     * @summary: lifts a distribution on blocks back to the original states, splitting the mass
+     * of each block in proportion to weights. For lumpings that come from symmetries (states that
+     * are exchangeable), uniform weights recover the original stationary distribution
+     * @param lc: lumped chain
+     * @param blockDist: 1 x (number of blocks) distribution
+     * @param weights: 1 x N nonnegative weights; empty means uniform within each block
+     * @return: 1 x N distribution
+     */
+    Eigen::MatrixXd lift_distribution(const LumpedChain& lc, const Eigen::MatrixXd& blockDist, const Eigen::MatrixXd& weights = Eigen::MatrixXd());
+
+    /**
+     * @summary: lifts per-block values to per-state values. Hitting times of (unions of)
+     * blocks, and anything else that depends only on the block, are constant on blocks
+     * under ordinary lumpability, so this is exact for them
+     * @param lc: lumped chain
+     * @param blockValues: one value per block
+     * @return: one value per original state
+     */
+    Eigen::VectorXd lift_values(const LumpedChain& lc, const Eigen::VectorXd& blockValues);
+}
+
+#endif
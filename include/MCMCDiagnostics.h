@@ -0,0 +1,213 @@
+/**
+ * @summary : streaming MCMC convergence diagnostics: running moments, batch-means ESS,
+ * split R-hat across chains and lag autocorrelations, each updated in O(1) per sample.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef MCMCDiagnostics_h
+#define MCMCDiagnostics_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<vector>
+#include<limits>
+#include"Sink.h"
+using namespace std;
+namespace Markov
+{
+    /**
+     Welford's running mean and sum of squared deviations. merge() combines two runs
+     (Chan, Golub and LeVeque), so moments of pieces add up exactly to the moments of the whole.
+     */
+    struct RunningMoments
+    {
+        long n = 0;
+        double mean = 0.0;
+        double M2 = 0.0;
+
+        void add(double x) noexcept
+        {
+            n++;
+            double delta = x - mean;
+            mean += delta/n;
+            M2 += delta*(x - mean);
+        }
+        void merge(const RunningMoments& other) noexcept;
+        //sample variance, n - 1 in the denominator
+        double variance() const noexcept { return n > 1 ? M2/(n - 1) : 0.0; }
+    };
+
+    /**
+     Batch means with a fixed number of batches: when maxBatches batches are full, neighbouring
+     pairs are merged and the batch size doubles, so memory stays O(maxBatches) and the
+     amortized cost per sample is O(1). Each batch keeps its own moments, which is what
+     split R-hat needs for the two halves of the chain.
+     */
+    class BatchMeans
+    {
+    protected:
+        int maxBatches = 64;
+        long batchSize = 1;
+        std::vector<RunningMoments> batches; //complete batches, in order
+        RunningMoments current; //batch being filled
+        RunningMoments total;
+
+        void collapse() noexcept;
+
+    public:
+        /**
+         * @param maxBatches: batches kept, rounded up to an even number >= 4
+         */
+        BatchMeans(int maxBatches = 64);
+
+        void add(double x) noexcept
+        {
+            total.add(x);
+            current.add(x);
+            if(current.n == batchSize){
+                batches.push_back(current);
+                current = RunningMoments();
+                if(static_cast<int>(batches.size()) == maxBatches){
+                    collapse();
+                }
+            }
+        }
+
+        long count() const noexcept { return total.n; }
+        double mean() const noexcept { return total.mean; }
+        double variance() const noexcept { return total.variance(); }
+        long getBatchSize() const noexcept { return batchSize; }
+        const std::vector<RunningMoments>& getBatches() const noexcept { return batches; }
+        const RunningMoments& moments() const noexcept { return total; }
+
+        /**
+         * @return: batch-means estimate of the asymptotic variance, batch size times the
+         * variance of the complete batches' means; 0 with fewer than 2 batches
+         */
+        double asymptoticVariance() const noexcept;
+
+        /**
+         * @return: effective sample size n * variance / asymptoticVariance, capped at n
+         */
+        double ess() const noexcept;
+
+        /**
+         * @return: moments of the first and second halves of the complete batches; with an odd
+         * number of batches the middle one is left out
+         */
+        std::pair<RunningMoments, RunningMoments> halves() const noexcept;
+    };
+
+    /**
+     Lag 0..maxLag autocovariances from running lagged cross sums over a ring buffer of the
+     last maxLag values, so no trace is stored and no FFT is needed. Each sample costs O(maxLag),
+     constant for a fixed maxLag. Values are shifted by the first sample before summing, to
+     keep the cancellation in S_k - n mean^2 small.
+     */
+    class OnlineAutocorrelation
+    {
+    protected:
+        int maxLag = 0;
+        long n = 0;
+        double shift = 0.0;
+        double sum = 0.0;
+        std::vector<double> ring;
+        std::vector<double> lagSums; //[k] = sum over t of y_t y_{t-k}
+        std::vector<double> headSums; //[k] = sum of the first k values
+        int pos = 0;
+
+    public:
+        OnlineAutocorrelation(int maxLag = 50);
+
+        void add(double x) noexcept;
+
+        long count() const noexcept { return n; }
+        int getMaxLag() const noexcept { return maxLag; }
+        double autocovariance(int k) const noexcept;
+        double autocorrelation(int k) const noexcept;
+
+        /**
+         * @return: integrated autocorrelation time 1 + 2 sum rho_k, truncated by Geyer's
+         * initial positive sequence rule (stop at the first pair rho_2m + rho_2m+1 <= 0)
+         */
+        double integratedTime() const noexcept;
+        double ess() const noexcept { return n/integratedTime(); }
+    };
+
+    /**
+     Diagnostics for one chain of d-dimensional samples: batch means for every coordinate and,
+     if maxLag > 0, lag autocorrelations. A monitor is a sink: monitor(t, x) adds x, with x a
+     number (a state of generateSequence, a 1-D IMH sample) or an Eigen vector, and returns
+     false once every coordinate has reached the target ESS, which stops the
+     samplers that feed it. The ESS is checked every checkInterval samples, since it costs
+     O(batches).
+     */
+    class ChainMonitor
+    {
+    protected:
+        std::vector<BatchMeans> coords;
+        std::vector<OnlineAutocorrelation> acf;
+        double targetESS = std::numeric_limits<double>::infinity();
+        long checkInterval = 1000;
+        bool reached = false;
+
+        bool check() noexcept;
+
+    public:
+        /**
+         * @param dim: coordinates per sample
+         * @param maxLag: largest autocorrelation lag tracked, 0 for none
+         * @param maxBatches: see BatchMeans
+         */
+        ChainMonitor(int dim = 1, int maxLag = 0, int maxBatches = 64);
+
+        /**
+         * @param ess: stop once the smallest coordinate ESS reaches this. With K chains,
+         * each monitor's target is its share of the total
+         * @param checkEvery: samples between checks
+         */
+        void setTargetESS(double ess, long checkEvery = 1000) noexcept;
+
+        //both throw if the sample's size is not dim()
+        bool add(double x);
+        bool add(const Eigen::Ref<const Eigen::VectorXd>& x);
+
+        template<typename Index, typename Point>
+        bool operator()(Index, const Point& x) { return add(x); }
+
+        int dim() const noexcept { return coords.size(); }
+        long count() const noexcept { return coords.empty() ? 0 : coords[0].count(); }
+        bool targetReached() const noexcept { return reached; }
+        const BatchMeans& coordinate(int j) const noexcept { return coords[j]; }
+        double mean(int j = 0) const noexcept { return coords[j].mean(); }
+        double variance(int j = 0) const noexcept { return coords[j].variance(); }
+        double ess(int j = 0) const noexcept { return coords[j].ess(); }
+        double minESS() const noexcept;
+        //throws if maxLag was 0
+        const OnlineAutocorrelation& autocorrelation(int j = 0) const;
+    };
+
+    /**
+     * @summary: split R-hat (Gelman et al., BDA3 section 11.4) of coordinate j: every chain
+     * is split into halves, and the between-half variance is compared with the within-half
+     * variance. Values near 1 (below 1.01 is the usual bar) mean the chains agree
+     * @return: R-hat, or infinity if the chains are too short to split
+     */
+    double split_rhat(const std::vector<ChainMonitor>& chains, int j = 0) noexcept;
+
+    /**
+     * @return: largest split R-hat over all coordinates
+     */
+    double max_split_rhat(const std::vector<ChainMonitor>& chains) noexcept;
+
+    /**
+     * @return: total batch-means ESS of coordinate j over all chains
+     */
+    double multi_chain_ess(const std::vector<ChainMonitor>& chains, int j = 0) noexcept;
+}
+
+#endif
@@ -9,16 +9,17 @@
 #ifndef MarkovChain_h
 #define MarkovChain_h
 
-class MarkovChain;
 #ifdef Success
 #undef Success
 #endif
 #include<Eigen/Core>
 #include <Eigen/QR>
 #include<Eigen/Dense>
+#include<Eigen/Sparse>
 #include<mkl.h>
 #include<type_traits>
 #include<complex>
+#include<functional>
 #include"MarkovFunctions.h"
 using namespace std;
 using namespace Markov;
@@ -35,19 +36,39 @@ namespace Markov
         }
     }Sequence;
 
-class MarkovChain
+/**
+ Scalar is the floating-point type the transition matrix and initial distribution are stored in.
+ BasicMarkovChain<float> halves the memory traffic of simulation and of vector-matrix products;
+ the linear solves (stationary distribution, hitting times) still return double-accurate
+ answers through mixed-precision refinement. Use the MarkovChain (double) and MarkovChainf
+ (float) typedefs below.
+ */
+template<typename Scalar>
+class BasicMarkovChain
 {
     
+public:
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> MatrixType;
+    typedef Eigen::Matrix<Scalar, 1, Eigen::Dynamic> RowVectorType;
+    
 protected:
     unsigned numStates;
-    Eigen::MatrixXd _transition, _initial;
+    MatrixType _transition, _initial;
+    //solve the linear systems with float factorizations and double residual correction?
+    bool mixedPrecision = std::is_same<Scalar, float>::value;
+    
+    /**
+     * @summary: solves A x = c, the system behind every hitting-time computation, with
+     * mixed-precision refinement if enabled and QR otherwise
+     */
+    Eigen::VectorXd solve(const Eigen::MatrixXd& A, const Eigen::VectorXd& c) const;
     
 public:
     
-    friend ostream& operator<<(ostream &os, const MarkovChain &MC){
+    friend ostream& operator<<(ostream &os, const BasicMarkovChain &MC){
         os << "Probability Matrix:" <<"\n";
         auto ns = MC.getNumStates();
-        Eigen::MatrixXd mat =  MC.getTransition();
+        MatrixType mat =  MC.getTransition();
         os << "  || ";
         for(int i = 0; i < ns; i++){
             os << i << " ";
@@ -77,24 +98,29 @@ public:
      * @param: initial: 1 x N initial probability row vector
      */
     
-    void setModel( const Eigen::MatrixXd& transition, const Eigen::MatrixXd& initial, int _numStates);
+    void setModel( const MatrixType& transition, const MatrixType& initial, int _numStates);
     
-    void setTransition(const Eigen::MatrixXd& transition);
-    void setInitial(const Eigen::MatrixXd& initial);
+    void setTransition(const MatrixType& transition);
+    void setInitial(const MatrixType& initial);
     void setNumStates(int _num);
+    /**
+     * @summary: turns mixed-precision refinement on or off for the linear solves. On by
+     * default for float chains, off for double chains
+     */
+    void setMixedPrecision(bool on);
     
-    Eigen::MatrixXd getTransition() const;
-    Eigen::MatrixXd getInit() const;
+    MatrixType getTransition() const;
+    MatrixType getInit() const;
     int getNumStates() const;
     
-    MarkovChain() {}
+    BasicMarkovChain() {}
     
-    MarkovChain( const Eigen::MatrixXd& transition, const Eigen::MatrixXd& initial, int _numStates){
+    BasicMarkovChain( const MatrixType& transition, const MatrixType& initial, int _numStates){
         _transition = transition;
         _initial = initial;
         numStates = _numStates;
     }
-    ~MarkovChain(){
+    ~BasicMarkovChain(){
         _transition.resize(0,0);
         _initial.resize(0,0);
         numStates = 0;
@@ -108,7 +134,7 @@ public:
      * @param oversize: upper bound on the number of states in the chain
      * @return: maximum likelihood estimator of _transition
      */
-    static Eigen::MatrixXd MLE(const vector<Sequence>& df, int oversize = 100);
+    static MatrixType MLE(const vector<Sequence>& df, int oversize = 100);
     
     /**
      * @name MarkovChain::generateSequence
@@ -117,6 +143,28 @@ public:
      * @return: vector of ints representing the sequence
      */
     vector<int> generateSequence(int n) const noexcept;
+    
+    /**
+     * @summary: as above, drawing from gen, so a seeded RNG reproduces the sequence
+     * @param gen: random engine
+     */
+    template<typename Engine>
+    vector<int> generateSequence(int n, Engine& gen) const noexcept
+    {
+        return generate_mc_sequence(n, _transition, _initial, gen);
+    }
+    
+    /**
+     * @summary: streams a sequence of at most maxLength states to sink(t, state), stopping
+     * early if the sink returns false; see generate_mc_sequence
+     * @param gen: random engine
+     * @return: number of states generated
+     */
+    template<typename Engine, typename Sink>
+    int generateSequence(int maxLength, Engine& gen, Sink&& sink) const
+    {
+        return generate_mc_sequence(maxLength, _transition, _initial, gen, sink);
+    }
     /**
      * @name MarkovChain::stationaryDistributions
      * @summary: stationaryDistributions returns the last stationary distributions of the
@@ -125,13 +173,21 @@ public:
      */
     Eigen::MatrixXcd stationaryDistributions() const;
     
+    /**
+     * @name MarkovChain::stationaryDistribution
+     * @summary: solves pi * P = pi, sum(pi) = 1 directly as a linear system rather than
+     * through the eigenvectors. Assumes the chain is irreducible
+     * @return: 1 x N stationary distribution, in double whatever Scalar is
+     */
+    Eigen::MatrixXd stationaryDistribution() const;
+    
     /**
      * @name MarkovChain::limitingDistribution
      * @summary: limitingDistribution computes the limiting distribution of the Markov chain
      * @param expon: computes 10^expon powers of _transition
      * @return limmat.row(0): limiting distribution
      */
-    Eigen::MatrixXd limitingDistribution(int expon) const;
+    MatrixType limitingDistribution(int expon) const;
     
     /**
      * @name MarkovChain::limitingMat
@@ -139,24 +195,49 @@ public:
      * @param expon: computes 10^expon powers of _transition
      * @return limmat: limiting distribution matrix
      */
-    Eigen::MatrixXd limitingMat(int expon) const;
+    MatrixType limitingMat(int expon) const;
+    
+    /**
+     * @name MarkovChain::distributionAt
+     * @summary: distribution of X_t, computed by propagating _initial instead of forming
+     * the full N x N matrix power. Short horizons use repeated vector-matrix products
+     * (sparse if _transition is mostly zeros), long horizons use repeated squaring
+     * @param t: time
+     * @return: 1 x N row vector, _initial * _transition^t
+     */
+    MatrixType distributionAt(int t) const;
+    
+    /**
+     * @name MarkovChain::distributionTrajectory
+     * @param T: last time
+     * @return: (T+1) x N matrix whose row t is the distribution of X_t
+     */
+    MatrixType distributionTrajectory(int T) const;
+    
+    /**
+     * @name MarkovChain::distributionTrajectory
+     * @summary: streaming version of the above; nothing but the current distribution is stored
+     * @param T: last time
+     * @param callback: called as callback(t, dist_t) for t = 0, 1, ..., T
+     */
+    void distributionTrajectory(int T, const std::function<void(int, const RowVectorType&)>& callback) const;
     
     /**
      * @summary: does mat contain key?
      * @return: answer to above question, true or false for yes or no
      */
-    bool contains(const Eigen::MatrixXd& mat, double key) const noexcept;
+    bool contains(const MatrixType& mat, double key) const noexcept;
     /**
      * @author: Zane Jakobs
      * @return: matrix of number of paths of length n from state i to state j
      */
-    Eigen::MatrixXd numPaths(int n) const;
+    MatrixType numPaths(int n) const;
     
     /**
      * @author: Zane Jakobs
      * @return 1 or 0 for if state j can be reached from state i
      */
-    Eigen::MatrixXd isReachable() const;
+    MatrixType isReachable() const;
     
     template<typename T>
     constexpr static bool isInVec(const std::vector<T>& v, T key);
@@ -164,7 +245,7 @@ public:
      * @author: Zane Jakobs
      * @return matrix where each row has a 1 in the column of each element in that communicating class (one row = one class)
      */
-    Eigen::MatrixXd communicatingClasses() const;
+    MatrixType communicatingClasses() const;
  
     
     /**
@@ -210,6 +291,11 @@ public:
     double log_likelihood(const vector<Sequence>& df, int oversize) const;
 };
     
+    typedef BasicMarkovChain<double> MarkovChain;
+    typedef BasicMarkovChain<float> MarkovChainf;
+    
+    extern template class BasicMarkovChain<double>;
+    extern template class BasicMarkovChain<float>;
 }
 
 #endif
@@ -15,8 +15,12 @@
 #include<typeinfo>
 #include<complex>
 #include<Eigen/LU>
+#include<Eigen/Sparse>
 #include<utility>
 #include<type_traits>
+#include"AliasTable.h"
+#include"Sink.h"
+#include"RNG.h"
 using namespace std;
 using namespace Eigen;
 namespace Markov
@@ -95,6 +99,7 @@ namespace Markov
                    MatrixXcd& lambda);
 
     Eigen::MatrixXd normalize_rows(Eigen::MatrixXd &mat);
+    Eigen::MatrixXf normalize_rows(Eigen::MatrixXf &mat);
     /**
      *@author: Zane Jakobs
      *@param mat: matrix to raise to power, passed by value for safe use with class members
@@ -102,7 +107,84 @@ namespace Markov
      *@return: mat^expon
      */
     Eigen::MatrixXd matrix_power(const Eigen::MatrixXd& mat, const int& expon);
-    
+    /**
+     *@summary: single-precision version; the eigendecomposition is done in double, since
+     * LAPACKE_dgeev is what we link against, and the result is rounded back to float
+     */
+    Eigen::MatrixXf matrix_power(const Eigen::MatrixXf& mat, const int& expon);
+
+    /**
+     *@param dist: 1 x N row vector (probability distribution)
+     *@param mat: N x N transition matrix
+     *@param expon: power
+     *@return: dist * mat^expon, computed by repeated squaring of mat. Only the squares
+     * are matrix-matrix products; dist is folded in with vector-matrix products, so this
+     * needs no eigendecomposition and works for defective matrices
+     */
+    template<typename Scalar>
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> distribution_power(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>& dist,
+                                                                          Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> mat, int expon)
+    {
+        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> res = dist;
+        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> temp;
+        while(expon > 0){
+            if(expon & 1){
+                temp.noalias() = res * mat;
+                res.swap(temp);
+            }
+            expon >>= 1;
+            if(expon > 0){
+                temp.noalias() = mat * mat;
+                mat.swap(temp);
+            }
+        }
+        return res;
+    }
+
+    /**
+     *@summary: solves A x = b by mixed-precision iterative refinement: A is factored once in
+     * single precision (half the memory traffic of a double factorization), and the solution is
+     * corrected with residuals computed in double until it is accurate to double precision.
+     * Falls back to a double factorization if the refinement stalls, e.g. when A is too
+     * ill-conditioned for float
+     *@param A: N x N matrix
+     *@param b: right-hand side
+     *@param tol: stop when ||A x - b|| <= tol * ||b||
+     *@param maxIter: maximum number of refinement steps
+     *@return: x
+     */
+    Eigen::VectorXd mixed_precision_solve(const Eigen::MatrixXd& A, const Eigen::VectorXd& b, double tol = 1.0e-13, int maxIter = 30);
+
+    /**
+     *@param RowVec: Eigen row vector type matching the scalar type of Mat
+     *@param Mat: dense or sparse Eigen matrix
+     *@param dist: 1 x N row vector (probability distribution)
+     *@param mat: N x N transition matrix
+     *@param steps: how many steps to take
+     *@param callback: called as callback(t, dist_t) for t = 0, 1, ..., steps
+     *@return: dist * mat^steps, computed with steps-many vector-matrix products (GEMV
+     * or SpMV, depending on Mat), so the cost is O(steps * nnz(mat))
+     */
+    template<typename RowVec, typename Mat, typename Callback>
+    RowVec propagate_distribution(const RowVec& dist, const Mat& mat, int steps, Callback&& callback)
+    {
+        RowVec cur = dist;
+        RowVec next(dist.cols());
+        callback(0, cur);
+        for(int t = 1; t <= steps; t++){
+            next.noalias() = cur * mat;
+            cur.swap(next);
+            callback(t, cur);
+        }
+        return cur;
+    }
+
+    template<typename RowVec, typename Mat>
+    RowVec propagate_distribution(const RowVec& dist, const Mat& mat, int steps)
+    {
+        return propagate_distribution(dist, mat, steps, [](int, const RowVec&){});
+    }
+
     /**
      * @author: Zane Jakobs
      * @param M: type of thing we're taking the polynomial of--specialized for
@@ -115,29 +197,104 @@ namespace Markov
     /**
      * @name MarkovChain::randTransition
      * @summary: initialRand: generates random state
-     * @param matrix: transition matrix
+     * @param matrix: transition matrix, of any scalar type
      * @param index: current state
      * @param u: random uniform between 0 and 1
      * @return index corresponding to the transition we make
      */
-    constexpr int random_transition(const Eigen::MatrixXd &mat, int nStates, int init_state, double r) noexcept{
-        auto s = mat(init_state,0);
+    template<typename Derived>
+    constexpr int random_transition(const Eigen::MatrixBase<Derived> &mat, int nStates, int init_state, double r) noexcept{
+        double s = mat(init_state,0);
         int i = 0;
-        while(r > s && (i < nStates)){
+        //stop at the last state, in case rounding leaves the row sum slightly below r
+        while(r > s && (i < nStates - 1)){
             i++;
             s += mat(init_state,i);
         }
         
         return i;
     }
+    /**
+     * @summary: solves pi * Q = 0, sum(pi) = 1 for the generator Q of an irreducible
+     * chain. Discrete chains use Q = P - I, so this is shared by MarkovChain and
+     * ContinuousMarkovChain
+     * @param Q: N x N generator matrix (rows sum to 0)
+     * @param mixedPrecision: solve with mixed_precision_solve instead of a double factorization
+     * @return: 1 x N stationary distribution
+     */
+    Eigen::MatrixXd stationary_from_generator(const Eigen::MatrixXd& Q, bool mixedPrecision = false);
+    
+    /**
+     * @summary: sparse version of the above, using a sparse LU factorization
+     */
+    Eigen::MatrixXd stationary_from_generator(const Eigen::SparseMatrix<double>& Q);
+    
     /**
      * @name MarkovChain::generate_mc_sequence
      * @summary: generateSequence generates a sequence of length n from the Markov chain
      * @param n: length of sequence
      * @param matT: transition matrix
      * @param initialDist: initial distribution
+     * @param gen: random engine, e.g. an RNG
      * @return: vector of ints representing the sequence
      */
-    vector<int> generate_mc_sequence(int n, const Eigen::MatrixXd& matT, const Eigen::MatrixXd& initialDist) noexcept;
+    template<typename Derived, typename InitDerived, typename Engine>
+    vector<int> generate_mc_sequence(int n, const Eigen::MatrixBase<Derived>& matT, const Eigen::MatrixBase<InitDerived>& initialDist, Engine& gen) noexcept
+    {
+        unsigned numStates = matT.cols();
+        std::vector<int> sequence(n > 0 ? n : 0);
+        if(n < 1){
+            return sequence;
+        }
+        // unif(0,1)
+        uniform_real_distribution<> dis(0.0,1.0);
+        
+        //initial state chosen by random transition from state 0 according to
+        //initial distribution
+        int id = random_transition(initialDist, numStates, 0, dis(gen));
+        sequence[0] = id;
+        for(int i = 1; i < n; i++){
+            id = random_transition(matT, numStates, id, dis(gen));
+            sequence[i] = id;
+        }
+        return sequence;
+    }
+    
+    /**
+     * @summary: as above, drawing from the calling thread's default_rng()
+     */
+    template<typename Derived, typename InitDerived>
+    vector<int> generate_mc_sequence(int n, const Eigen::MatrixBase<Derived>& matT, const Eigen::MatrixBase<InitDerived>& initialDist) noexcept
+    {
+        return generate_mc_sequence(n, matT, initialDist, default_rng());
+    }
+    
+    /**
+     * @summary: streams a sequence from the Markov chain to sink(t, state) instead of storing
+     * it. A sink returning bool can end the sequence early by returning false; a
+     * ChainMonitor with a target ESS does this
+     * @param maxLength: most states generated
+     * @param gen: random engine
+     * @return: number of states generated
+     */
+    template<typename Derived, typename InitDerived, typename Engine, typename Sink>
+    int generate_mc_sequence(int maxLength, const Eigen::MatrixBase<Derived>& matT, const Eigen::MatrixBase<InitDerived>& initialDist, Engine& gen, Sink&& sink)
+    {
+        unsigned numStates = matT.cols();
+        if(maxLength < 1){
+            return 0;
+        }
+        uniform_real_distribution<> dis(0.0,1.0);
+        int id = random_transition(initialDist, numStates, 0, dis(gen));
+        for(int t = 0; t < maxLength; t++){
+            if(t > 0){
+                id = random_transition(matT, numStates, id, dis(gen));
+            }
+            if(!call_sink(sink, t, id)){
+                return t + 1;
+            }
+        }
+        return maxLength;
+    }
 }
 #endif /* MarkovFunctions_hpp */
@@ -0,0 +1,160 @@
+/**
+ * @summary : versioned binary file format for Markov chains, loadable with mmap.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef MarkovIO_h
+#define MarkovIO_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/Sparse>
+#include<mkl.h>
+#include<cstdint>
+#include<cstddef>
+#include<string>
+#include"MarkovChain.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    /**
+     File layout (native byte order, every section starts on a 64-byte boundary):
+
+     header             MarkovFileHeader
+     transition         dense: N*N doubles, column-major (Eigen's default)
+                        sparse: CSR, nnz doubles of values, nnz int32 column indices,
+                        N+1 int32 row offsets
+     initial            N doubles
+     alias (optional)   per-row alias tables over the row's entries (all N columns if dense,
+                        the nonzeros if sparse): nnz doubles of probabilities, nnz int32 aliases
+     stationary (opt.)  N doubles
+
+     Offsets of 0 mean the section is absent. Nothing needs parsing, so a loader can point
+     Eigen maps straight at the mapped pages.
+     */
+    struct MarkovFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t numStates;
+        uint64_t nnz;
+        uint64_t valuesOffset;
+        uint64_t innerOffset;
+        uint64_t outerOffset;
+        uint64_t initialOffset;
+        uint64_t aliasProbOffset;
+        uint64_t aliasIndexOffset;
+        uint64_t stationaryOffset;
+        uint64_t fileSize;
+    };
+
+    const uint32_t markov_file_version = 1;
+
+    //flags for save_markov_chain, also stored in MarkovFileHeader::flags
+    enum MarkovFileFlags : uint32_t
+    {
+        MARKOV_FILE_SPARSE = 1,
+        MARKOV_FILE_ALIAS = 2,
+        MARKOV_FILE_STATIONARY = 4
+    };
+
+    /**
+     * @summary: writes mc to path in the format above
+     * @param flags: bitwise or of MarkovFileFlags. MARKOV_FILE_STATIONARY computes and stores
+     * the stationary distribution, MARKOV_FILE_ALIAS stores per-row alias tables
+     */
+    void save_markov_chain(const std::string& path, const MarkovChain& mc, uint32_t flags = 0);
+
+    /**
+     * @summary: sparse writer that never forms the dense matrix. Always stores CSR
+     * @param trans: N x N transition matrix
+     * @param initial: 1 x N initial distribution
+     * @param flags: bitwise or of MarkovFileFlags
+     */
+    void save_markov_chain(const std::string& path, const Eigen::SparseMatrix<double, Eigen::RowMajor>& trans,
+                           const Eigen::MatrixXd& initial, uint32_t flags = MARKOV_FILE_SPARSE);
+
+    /**
+     * @summary: read-only view of a chain file mapped with mmap(MAP_SHARED). Processes that map
+     * the same file share one copy in the page cache, and opening costs only header validation.
+     * Throws a string on a missing, truncated, or wrong-version file
+     */
+    class MappedMarkovChain
+    {
+    protected:
+        void* _base = nullptr;
+        size_t _size = 0;
+        const MarkovFileHeader* _header = nullptr;
+
+        template<typename T>
+        const T* section(uint64_t offset) const noexcept
+        {
+            return reinterpret_cast<const T*>(static_cast<const char*>(_base) + offset);
+        }
+
+    public:
+        MappedMarkovChain() {}
+        explicit MappedMarkovChain(const std::string& path);
+        ~MappedMarkovChain();
+
+        MappedMarkovChain(const MappedMarkovChain&) = delete;
+        MappedMarkovChain& operator=(const MappedMarkovChain&) = delete;
+        MappedMarkovChain(MappedMarkovChain&& other) noexcept;
+        MappedMarkovChain& operator=(MappedMarkovChain&& other) noexcept;
+
+        void open(const std::string& path);
+        void close() noexcept;
+
+        bool isOpen() const noexcept { return _header != nullptr; }
+        bool isSparse() const noexcept { return _header->flags & MARKOV_FILE_SPARSE; }
+        bool hasAliasTables() const noexcept { return _header->aliasProbOffset != 0; }
+        bool hasStationary() const noexcept { return _header->stationaryOffset != 0; }
+        int getNumStates() const noexcept { return static_cast<int>(_header->numStates); }
+        size_t nonZeros() const noexcept { return _header->nnz; }
+
+        /**
+         * @return: the dense transition matrix, in place. Only valid if !isSparse()
+         */
+        Eigen::Map<const Eigen::MatrixXd> denseTransition() const;
+
+        /**
+         * @return: the CSR transition matrix, in place. Only valid if isSparse()
+         */
+        Eigen::Map<const Eigen::SparseMatrix<double, Eigen::RowMajor, int> > sparseTransition() const;
+
+        Eigen::Map<const Eigen::RowVectorXd> initial() const;
+
+        /**
+         * @return: stored stationary distribution. Only valid if hasStationary()
+         */
+        Eigen::Map<const Eigen::RowVectorXd> stationary() const;
+
+        /**
+         * @summary: one transition using the stored alias tables. Only valid if hasAliasTables().
+         * A sparse row with no stored entries is treated as absorbing
+         * @param state: current state
+         * @param u: random uniform between 0 and 1
+         * @return: next state
+         */
+        int sampleTransition(int state, double u) const noexcept;
+
+        /**
+         * @return: a MarkovChain owning a dense copy of the data
+         */
+        MarkovChain toMarkovChain() const;
+    };
+
+    /**
+     * @return: MarkovChain read from a file written by save_markov_chain
+     */
+    MarkovChain load_markov_chain(const std::string& path);
+}
+
+#endif
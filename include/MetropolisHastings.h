@@ -0,0 +1,279 @@
+/**
+ * @summary : multi-chain random-walk Metropolis-Hastings with adaptive proposal covariance,
+ * for the same targets as perfect IMH.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef MetropolisHastings_h
+#define MetropolisHastings_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/Cholesky>
+#ifdef _OPENMP
+#include<omp.h>
+#endif
+#include<vector>
+#include<random>
+#include<cmath>
+#include<cstdint>
+#include<limits>
+#include<ostream>
+#include<type_traits>
+#include"Distributions.h"
+#include"MCMCDiagnostics.h"
+#include"Sink.h"
+#include"RNG.h"
+using namespace std;
+namespace Markov
+{
+    //overload priority for mh_log_density: higher ranks are tried first
+    template<int N> struct MHRank : MHRank<N-1> {};
+    template<> struct MHRank<0> {};
+
+    template<typename Dist>
+    auto mh_log_density(const Dist& dist, const Eigen::VectorXd& x, MHRank<3>) -> decltype(static_cast<double>(dist.logpdf(x)))
+    {
+        return dist.logpdf(x);
+    }
+    template<typename Dist>
+    auto mh_log_density(const Dist& dist, const Eigen::VectorXd& x, MHRank<2>) -> decltype(static_cast<double>(dist.pdf(x)))
+    {
+        return std::log(dist.pdf(x));
+    }
+    //1-D targets written for double, like the perfect IMH targets
+    template<typename Dist>
+    auto mh_log_density(const Dist& dist, const Eigen::VectorXd& x, MHRank<1>) -> decltype(static_cast<double>(dist.logpdf(x(0))))
+    {
+        return dist.logpdf(x(0));
+    }
+    template<typename Dist>
+    auto mh_log_density(const Dist& dist, const Eigen::VectorXd& x, MHRank<0>) -> decltype(static_cast<double>(dist.pdf(x(0))))
+    {
+        return std::log(dist.pdf(x(0)));
+    }
+
+    /**
+     *@brief: what one chain of AdaptiveMetropolis::run did
+     */
+    struct MHChainStats
+    {
+        long steps = 0;
+        long accepted = 0;
+        Eigen::VectorXd state; //state after the last step
+        Eigen::MatrixXd proposal; //proposal covariance in use at the end
+        double acceptanceRate() const noexcept { return steps ? static_cast<double>(accepted)/steps : 0.0; }
+    };
+
+    /**
+     *@brief: sink writing each sample as one CSV row, the format examples/MarkovHW11.cpp
+     * writes for plotting
+     */
+    class CSVSink
+    {
+    protected:
+        std::ostream* out;
+    public:
+        CSVSink(std::ostream& os) : out(&os) {}
+        void operator()(long /*t*/, const Eigen::VectorXd& x)
+        {
+            for(int j = 0; j < x.size(); j++){
+                *out << (j ? "," : "") << x(j);
+            }
+            *out << "\n";
+        }
+    };
+
+    /**
+     Random-walk Metropolis with the adaptive proposal of Haario, Saksman and Tamminen
+     (Bernoulli 7(2), 2001): after adaptStart steps, a chain proposes from
+     N(x, s_d (Cov(x_0..x_t) + epsilon I)) with s_d = 2.38^2 / d, Cov being the running
+     covariance of its own history. The covariance is updated in O(d^2) per step and
+     refactored every adaptInterval steps.
+
+     Chains run in parallel, each with its own stream RNG(seed, chain), so a run is
+     reproducible whatever the thread count. Samples go to one sink per chain, called as
+     sink(t, x) for every kept step t; nothing is stored, so runs can be as long as needed.
+     A sink may return bool, false stopping its chain early (see ChainMonitor).
+     The target needs a logpdf or pdf taking an Eigen::VectorXd, or, in one dimension, a double.
+     */
+    template<typename TargetDist>
+    class AdaptiveMetropolis
+    {
+    protected:
+        TargetDist pi;
+        int dimension = 0;
+        Eigen::MatrixXd starts; //row c is chain c's initial state; one row is shared by all
+        Eigen::MatrixXd initialFactor; //lower Cholesky factor of the initial proposal covariance
+        long burnIn = 0;
+        long thin = 1;
+        long adaptStart = 1000;
+        long adaptInterval = 50;
+        double scale = 0.0;
+        double epsilon = 1.0e-6;
+        bool adaptAfterBurnIn = true;
+
+        double log_target(const Eigen::VectorXd& x) const
+        {
+            double lp = mh_log_density(pi, x, MHRank<3>());
+            return std::isnan(lp) ? -std::numeric_limits<double>::infinity() : lp;
+        }
+
+        template<typename Sink>
+        MHChainStats run_chain(int chain, long steps, uint64_t seed, Sink& sink) const noexcept;
+
+    public:
+        /**
+         *@param target: distribution to sample
+         *@param x0: initial state of every chain
+         *@param proposalCov: proposal covariance until adaptation starts
+         */
+        AdaptiveMetropolis(const TargetDist& target, const Eigen::VectorXd& x0, const Eigen::MatrixXd& proposalCov)
+        : pi(target), dimension(x0.size()), starts(x0.transpose())
+        {
+            if(proposalCov.rows() != dimension || proposalCov.cols() != dimension){
+                throw "Error: proposal covariance does not match the dimension of the initial state.";
+            }
+            //checked here, since an exception cannot leave the parallel region in run
+            Eigen::LLT<Eigen::MatrixXd> llt(proposalCov);
+            if(llt.info() != Eigen::Success){
+                throw "Error: proposal covariance is not positive definite.";
+            }
+            initialFactor = llt.matrixL();
+            scale = 2.38*2.38/dimension;
+        }
+
+        /**
+         *@param x0: row c is chain c's initial state. Over-dispersed starts make the
+         * between-chain convergence checks meaningful
+         */
+        void setInitialStates(const Eigen::MatrixXd& x0)
+        {
+            if(x0.cols() != dimension){
+                throw "Error: initial states do not match the dimension of the target.";
+            }
+            starts = x0;
+        }
+        //steps discarded before samples are passed to the sinks
+        void setBurnIn(long b) noexcept { burnIn = b; }
+        //every thin-th step after burn-in is passed to the sinks
+        void setThin(long t) noexcept { thin = (t > 0) ? t : 1; }
+        /**
+         *@param start: steps on the initial proposal before adapting
+         *@param interval: steps between refactorizations of the adapted covariance
+         *@param afterBurnIn: keep adapting once burn-in is over. Haario et al. show the chain
+         * stays ergodic if so; false freezes the proposal for the kept samples
+         */
+        void setAdaptation(long start, long interval, bool afterBurnIn = true) noexcept
+        {
+            adaptStart = start;
+            adaptInterval = (interval > 0) ? interval : 1;
+            adaptAfterBurnIn = afterBurnIn;
+        }
+        void setScale(double s) noexcept { scale = s; }
+        void setEpsilon(double e) noexcept { epsilon = e; }
+        int getDimension() const noexcept { return dimension; }
+
+        /**
+         *@param steps: steps per chain, burn-in included
+         *@param seed: seed for the per-chain streams
+         *@param sinks: one per chain; chain c calls sinks[c](t, x). Each sink is only ever
+         * called from one thread at a time
+         *@param numThreads: number of threads, 0 for the OpenMP default
+         *@return: per-chain statistics
+         */
+        template<typename Sink>
+        std::vector<MHChainStats> run(long steps, uint64_t seed, std::vector<Sink>& sinks, int numThreads = 0) const
+        {
+            int chains = sinks.size();
+            if(starts.rows() != 1 && starts.rows() != chains){
+                throw "Error: need one initial state, or one per chain.";
+            }
+            //run_chain cannot throw from inside the parallel region, so monitors are checked here
+            if constexpr(std::is_same<Sink, ChainMonitor>::value){
+                for(const auto& m : sinks){
+                    if(m.dim() != dimension){
+                        throw "Error: every monitor needs the target's dimension.";
+                    }
+                }
+            }
+            std::vector<MHChainStats> stats(chains);
+            int threads = 1;
+#ifdef _OPENMP
+            threads = (numThreads > 0) ? numThreads : omp_get_max_threads();
+#endif
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+            for(int c = 0; c < chains; c++){
+                stats[c] = run_chain(c, steps, seed, sinks[c]);
+            }
+            return stats;
+        }
+    };
+
+    template<typename TargetDist>
+    template<typename Sink>
+    MHChainStats AdaptiveMetropolis<TargetDist>::run_chain(int chain, long steps, uint64_t seed, Sink& sink) const noexcept
+    {
+        RNG gen(seed, chain);
+        normal_distribution<double> normal(0.0,1.0);
+        uniform_real_distribution<double> unif(0.0,1.0);
+        const int d = dimension;
+
+        Eigen::VectorXd x = starts.row(starts.rows() == 1 ? 0 : chain).transpose();
+        double lp = log_target(x);
+        Eigen::MatrixXd L = initialFactor;
+        Eigen::MatrixXd cov(d, d);
+        Eigen::LLT<Eigen::MatrixXd> llt(d);
+
+        //running mean and sum of squared deviations of the chain's history (Welford)
+        Eigen::VectorXd mean = x;
+        Eigen::MatrixXd M2 = Eigen::MatrixXd::Zero(d, d);
+        Eigen::VectorXd delta(d), z(d), y(d);
+        long n = 1;
+
+        MHChainStats stats;
+        for(long t = 1; t <= steps; t++){
+            for(int j = 0; j < d; j++){
+                z(j) = normal(gen);
+            }
+            y.noalias() = x + L.triangularView<Eigen::Lower>() * z;
+            double lpy = log_target(y);
+            //accept with probability min(1, pi(y)/pi(x)); the proposal is symmetric
+            if(std::log(unif(gen)) < lpy - lp){
+                x.swap(y);
+                lp = lpy;
+                stats.accepted++;
+            }
+            stats.steps++;
+
+            n++;
+            delta = x - mean;
+            mean += delta/static_cast<double>(n);
+            M2.noalias() += delta * (x - mean).transpose();
+
+            bool adapting = t >= adaptStart && (adaptAfterBurnIn || t <= burnIn);
+            if(adapting && (t - adaptStart) % adaptInterval == 0){
+                cov = scale * (M2/static_cast<double>(n - 1) + epsilon * Eigen::MatrixXd::Identity(d, d));
+                llt.compute(cov);
+                //keep the previous factor if rounding cost positive definiteness
+                if(llt.info() == Eigen::Success){
+                    L = llt.matrixL();
+                }
+            }
+            //a sink returning false, such as a ChainMonitor at its target ESS, ends the chain
+            if(t > burnIn && (t - burnIn) % thin == 0 && !call_sink(sink, t, x)){
+                break;
+            }
+        }
+        stats.state = x;
+        stats.proposal = L * L.transpose();
+        return stats;
+    }
+}
+
+#endif
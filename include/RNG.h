@@ -0,0 +1,117 @@
+/**
+ * @summary : seedable random number context: a xoshiro256++ engine that splits into
+ * independent streams, and a thread-local default for calls that are not given one.
+ */
+#ifndef RNG_h
+#define RNG_h
+
+#include<cstdint>
+#include<limits>
+using namespace std;
+namespace Markov
+{
+    /**
+     * @source: Vigna, splitmix64, http://prng.di.unimi.it/splitmix64.c
+     */
+    inline uint64_t splitmix64(uint64_t& x) noexcept
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    /**
+     xoshiro256++ (Blackman and Vigna, http://prng.di.unimi.it/xoshiro256plusplus.c): 256 bits
+     of state, period 2^256 - 1, and a handful of shifts and adds per 64-bit draw, against a
+     syscall for every random_device. It is a UniformRandomBitGenerator, so it works with the
+     <random> distributions and with every sampler here that takes an Engine.
+
+     The state is filled from a 64-bit seed by splitmix64, so every seed, 0 included, gives a
+     good starting point. There are two ways to get several streams:
+     - split() returns a copy of this stream and jumps this one 2^128 draws ahead, so repeated
+       splits hand out streams that provably never overlap;
+     - RNG(seed, stream) seeds from the pair, one-to-one, so stream i can be built directly,
+       in any order, by whichever thread needs it, and no two (seed, stream) pairs share a
+       state. This is what the seeded parallel samplers use per block or per chain, since
+       their output must not depend on the schedule.
+     */
+    class RNG
+    {
+    protected:
+        uint64_t s[4];
+
+        static uint64_t rotl(uint64_t x, int k) noexcept
+        {
+            return (x << k) | (x >> (64 - k));
+        }
+
+    public:
+        typedef uint64_t result_type;
+
+        static constexpr result_type min() noexcept { return 0; }
+        static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+        explicit RNG(uint64_t seed = 0) noexcept { this->seed(seed); }
+        RNG(uint64_t seed, uint64_t stream) noexcept { this->seed(seed, stream); }
+
+        void seed(uint64_t seed) noexcept;
+        void seed(uint64_t seed, uint64_t stream) noexcept;
+
+        result_type operator()() noexcept
+        {
+            uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+            uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+            return result;
+        }
+
+        //uniform on [0,1) from the top 53 bits of one draw
+        double uniform() noexcept
+        {
+            return ((*this)() >> 11) * 0x1.0p-53;
+        }
+
+        /**
+         * @summary: advances the stream by 2^128 draws
+         */
+        void jump() noexcept;
+
+        /**
+         * @return: a generator continuing this stream; this one jumps 2^128 draws ahead
+         */
+        RNG split() noexcept
+        {
+            RNG child(*this);
+            jump();
+            return child;
+        }
+
+        bool operator==(const RNG& other) const noexcept
+        {
+            return s[0] == other.s[0] && s[1] == other.s[1] && s[2] == other.s[2] && s[3] == other.s[3];
+        }
+        bool operator!=(const RNG& other) const noexcept { return !(*this == other); }
+    };
+
+    /**
+     * @return: the calling thread's default generator, used by every sampler that is not given
+     * one. Each thread's default is seeded from random_device the first time it is used, which
+     * is the only random_device call that thread makes
+     */
+    RNG& default_rng() noexcept;
+
+    /**
+     * @summary: reseeds the calling thread's default generator, so single-threaded runs through
+     * the default overloads reproduce. Parallel code should take an RNG per thread or chain
+     * from split() or RNG(seed, stream) instead
+     */
+    void seed_default_rng(uint64_t seed) noexcept;
+}
+
+#endif
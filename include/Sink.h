@@ -0,0 +1,27 @@
+/**
+ * @summary : the sink protocol shared by the streaming samplers and the diagnostics.
+ */
+#ifndef Sink_hpp
+#define Sink_hpp
+#include<utility>
+#include<type_traits>
+namespace Markov
+{
+    /**
+     * @summary: calls sink(args...). Sinks may return void, or bool with false meaning the
+     * producer should stop
+     * @return: false if the sink asked to stop
+     */
+    template<typename Sink, typename... Args>
+    bool call_sink(Sink&& sink, Args&&... args)
+    {
+        if constexpr(std::is_void<decltype(sink(std::forward<Args>(args)...))>::value){
+            sink(std::forward<Args>(args)...);
+            return true;
+        } else{
+            return static_cast<bool>(sink(std::forward<Args>(args)...));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @summary : per-row sampling tables for skewed transition matrices: nonzeros sorted by
+ * descending probability for low-entropy rows, alias tables for the rest.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+
+#ifndef TransitionSampler_h
+#define TransitionSampler_h
+
+#ifdef Success
+#undef Success
+#endif
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/Sparse>
+#include<mkl.h>
+#include<vector>
+#include<random>
+#include"MarkovChain.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    enum RowLayout
+    {
+        ROW_SORTED = 0, //nonzeros by descending probability, scanned with early exit
+        ROW_ALIAS = 1,  //alias table over the nonzeros
+        ROW_ADAPTIVE = 2 //chosen per row from its entropy
+    };
+
+    /**
+     Rows are stored CSR-style over their nonzeros only. A sorted row keeps cumulative
+     probabilities in descending order of probability, so a scan stops after
+     sum_k k * p_(k) comparisons on average -- about 1 when one entry carries most of the mass,
+     against N/2 for the index-order scan in random_transition. Rows whose mass is spread out
+     get an alias table instead, which costs the same two lookups whatever the row looks like.
+     */
+    class TransitionSampler
+    {
+    protected:
+        int numStates = 0;
+        std::vector<int> _offsets; //row i occupies [_offsets[i], _offsets[i+1])
+        std::vector<int> _index; //original column of each stored entry
+        //sorted rows: cumulative probability; alias rows: the alias table's probability
+        std::vector<double> _value;
+        std::vector<int> _alias; //alias rows only: alias, as a position within the row
+        std::vector<char> _useAlias;
+
+        template<typename RowIterator>
+        void addRow(int row, RowIterator begin, RowIterator end, RowLayout layout, double entropyCutoff);
+
+    public:
+        TransitionSampler() {}
+
+        /**
+         * @param transition: N x N transition matrix
+         * @param layout: layout used for every row, or ROW_ADAPTIVE to choose per row
+         * @param entropyCutoff: with ROW_ADAPTIVE, rows with entropy (in bits) at most this
+         * are sorted and the rest use alias tables. The default of 2 bits means rows that
+         * behave like they have 4 or fewer likely successors are scanned
+         */
+        TransitionSampler(const Eigen::MatrixXd& transition, RowLayout layout = ROW_ADAPTIVE, double entropyCutoff = 2.0);
+        TransitionSampler(const Eigen::SparseMatrix<double, Eigen::RowMajor>& transition, RowLayout layout = ROW_ADAPTIVE, double entropyCutoff = 2.0);
+        TransitionSampler(const MarkovChain& mc, RowLayout layout = ROW_ADAPTIVE, double entropyCutoff = 2.0);
+
+        /**
+         * @param state: current state
+         * @param u: random uniform between 0 and 1
+         * @return: next state
+         */
+        int sample(int state, double u) const noexcept
+        {
+            int b = _offsets[state];
+            int e = _offsets[state+1];
+            if(_useAlias[state]){
+                int k = e - b;
+                double x = u * k;
+                int i = static_cast<int>(x);
+                if(i >= k){
+                    i = k - 1;
+                }
+                return (x - i < _value[b+i]) ? _index[b+i] : _index[b + _alias[b+i]];
+            }
+            //the last entry catches u above a cumulative sum that rounded below 1
+            while(b < e - 1 && u > _value[b]){
+                b++;
+            }
+            return _index[b];
+        }
+
+        /**
+         * @param initialDist: 1 x N initial distribution
+         * @param n: length of sequence
+         * @param gen: random engine
+         * @return: vector of ints representing the sequence
+         */
+        template<typename Engine>
+        vector<int> generateSequence(const Eigen::MatrixXd& initialDist, int n, Engine& gen) const
+        {
+            std::vector<int> sequence(n > 0 ? n : 0);
+            if(n < 1){
+                return sequence;
+            }
+            uniform_real_distribution<> dis(0.0,1.0);
+            int id = random_transition(initialDist, numStates, 0, dis(gen));
+            sequence[0] = id;
+            for(int i = 1; i < n; i++){
+                id = sample(id, dis(gen));
+                sequence[i] = id;
+            }
+            return sequence;
+        }
+
+        int getNumStates() const noexcept { return numStates; }
+        bool isAliasRow(int state) const noexcept { return _useAlias[state]; }
+
+        /**
+         * @return: expected number of entries a sample from this row reads: the expected scan
+         * length for sorted rows, 1 for alias rows
+         */
+        double expectedCost(int state) const noexcept;
+    };
+
+    /**
+     * @param p: probabilities, need not be normalized
+     * @param n: number of probabilities
+     * @return: Shannon entropy in bits of p / sum(p)
+     */
+    double row_entropy(const double* p, int n) noexcept;
+}
+
+#endif
@@ -1,47 +1,353 @@
 #ifndef pIMH_hpp
 #define pIMH_hpp
 #include "Distributions.h"
+#include "Sink.h"
+#include "RNG.h"
 #include<mkl.h>
+#ifdef _OPENMP
 #include<omp.h>
+#endif
 #include<stdio.h>
 #include<random>
 #include<numeric>
 #include<vector>
 #include<array>
 #include<utility>
+#include<algorithm>
+#include<cmath>
+#include<limits>
+#include<type_traits>
+#include<Eigen/Core>
+#include<cstdint>
 
 using namespace std;
 namespace Markov
 {
+    /**
+     *@brief: uniforms and candidates drawn for perfect IMH, indexed backwards in time:
+     * entry k holds the pair used by the transition at time -k. Pushing further into the
+     * past is a push_back, amortized O(1), and nothing already drawn moves. clear() keeps
+     * the storage, so one history serves every sample a thread draws
+     */
+    struct IMHHistory
+    {
+        std::vector<double> uniforms;
+        std::vector<double> candidates;
+        /*
+         weights[k] = pi(candidates[k]) / Q(candidates[k]), or its log in the log domain. Filled
+         in as the backward search reaches each candidate, so candidates drawn past the
+         coalescence time are never scored
+         */
+        std::vector<double> weights;
+        
+        void clear() noexcept
+        {
+            uniforms.clear();
+            candidates.clear();
+            weights.clear();
+        }
+        std::size_t size() const noexcept { return uniforms.size(); }
+    };
+    
+    /**
+     *@brief: IMHHistory for vector states. Candidates are the rows of a column-major matrix,
+     * row k for time -k, so each coordinate of a block of candidates is contiguous (SoA) and
+     * whole blocks are drawn and scored at once. Rows past size() are spare capacity: the
+     * matrix doubles when full and is never shrunk. Scoring solves in work, which also only
+     * grows, so with distributions whose logpdf_block takes a workspace (MultivariateNormal,
+     * MultivariateStudentT) a sample allocates nothing after warm-up
+     */
+    struct IMHBlockHistory
+    {
+        std::vector<double> uniforms;
+        Eigen::MatrixXd candidates;
+        std::vector<double> weights;
+        //log Q of the block being scored, kept to avoid reallocating it
+        std::vector<double> scratch;
+        //workspace for logpdf_block
+        Eigen::MatrixXd work;
+        
+        void clear() noexcept
+        {
+            uniforms.clear();
+            weights.clear();
+        }
+        std::size_t size() const noexcept { return uniforms.size(); }
+        
+        /**
+         *@brief: makes room for rows candidates, keeping the first size()
+         */
+        void reserve(std::size_t rows, int dim)
+        {
+            if(candidates.cols() != dim){
+                candidates.resize(0, dim);
+            }
+            if(rows > static_cast<std::size_t>(candidates.rows())){
+                candidates.conservativeResize(std::max(rows, 2*static_cast<std::size_t>(candidates.rows())), dim);
+            }
+        }
+    };
+
+    /**
+     *@brief: expands from a and b in the downhill direction by golden-ratio steps until
+     * three points bracket a minimum of f. A plateau, f(c) equal to f(b) up to rounding,
+     * counts as bracketed, so a constant f (pi == Q, where any point is a valid lower
+     * bound) is not mistaken for an unbounded one
+     *@post: on success, b lies between a and c, f(b) <= f(a) and f(b) <= f(c) up to rounding
+     *@return: false if f kept strictly decreasing for maxSteps expansions
+     */
+    template<typename Function>
+    bool bracket_minimum(Function&& f, double& a, double& b, double& c, int maxSteps = 200)
+    {
+        const double golden = 1.618033988749895;
+        double fa = f(a);
+        double fb = f(b);
+        if(fb > fa){
+            std::swap(a, b);
+            std::swap(fa, fb);
+        }
+        //relative slack below which a decrease is taken as rounding on a plateau
+        const double flat = 1.0e-12;
+        c = b + golden*(b - a);
+        double fc = f(c);
+        for(int i = 0; fc < fb - flat*(1.0 + std::abs(fb)); i++){
+            if(i == maxSteps){
+                return false;
+            }
+            a = b;
+            b = c;
+            fb = fc;
+            c = b + golden*(b - a);
+            fc = f(c);
+        }
+        return true;
+    }
+    
+    /**
+     *@brief: Brent's method: golden-section search, with parabolic steps through the three
+     * best points so far whenever they are finite and the step stays inside the bracket
+     *@param a, b, c: bracket from bracket_minimum
+     *@param tol: relative tolerance on the minimizer; below about sqrt(machine epsilon)
+     * buys nothing, since f is flat to rounding that close to its minimum
+     *@return: minimizer of f in the bracket
+     */
+    template<typename Function>
+    double brent_minimize(Function&& f, double a, double b, double c, double tol = 1.0e-8, int maxIter = 200)
+    {
+        const double cgold = 0.3819660112501051;
+        double lo = std::min(a, c);
+        double hi = std::max(a, c);
+        double x = b, w = b, v = b;
+        double fx = f(x);
+        double fw = fx, fv = fx;
+        double d = 0.0, e = 0.0;
+        for(int it = 0; it < maxIter; it++){
+            double mid = 0.5*(lo + hi);
+            double tol1 = tol*std::abs(x) + 1.0e-12;
+            double tol2 = 2.0*tol1;
+            if(std::abs(x - mid) <= tol2 - 0.5*(hi - lo)){
+                break;
+            }
+            bool golden = true;
+            if(std::abs(e) > tol1 && std::isfinite(fx) && std::isfinite(fw) && std::isfinite(fv)){
+                double r = (x - w)*(fx - fv);
+                double q = (x - v)*(fx - fw);
+                double p = (x - v)*q - (x - w)*r;
+                q = 2.0*(q - r);
+                if(q > 0){
+                    p = -p;
+                }
+                q = std::abs(q);
+                double etemp = e;
+                e = d;
+                //take the parabolic step only if it is smaller than half the step before last
+                if(std::abs(p) < std::abs(0.5*q*etemp) && p > q*(lo - x) && p < q*(hi - x)){
+                    d = p/q;
+                    double u = x + d;
+                    if(u - lo < tol2 || hi - u < tol2){
+                        d = (mid >= x) ? tol1 : -tol1;
+                    }
+                    golden = false;
+                }
+            }
+            if(golden){
+                e = (x >= mid) ? lo - x : hi - x;
+                d = cgold*e;
+            }
+            double u = (std::abs(d) >= tol1) ? x + d : x + ((d >= 0) ? tol1 : -tol1);
+            double fu = f(u);
+            if(fu <= fx){
+                if(u >= x){
+                    lo = x;
+                } else{
+                    hi = x;
+                }
+                v = w; fv = fw;
+                w = x; fw = fx;
+                x = u; fx = fu;
+            } else{
+                if(u < x){
+                    lo = u;
+                } else{
+                    hi = u;
+                }
+                if(fu <= fw || w == x){
+                    v = w; fv = fw;
+                    w = u; fw = fu;
+                } else if(fu <= fv || v == x || v == w){
+                    v = u; fv = fu;
+                }
+            }
+        }
+        return x;
+    }
 
     /**
      *@author: Zane Jakobs
      *@brief: a class to run the perfect independent Metropolis Hastings algorithm
      developed by Jem Corcoran and R.L. Tweedie. Original paper at
      https://projecteuclid.org/euclid.aoap/1015345299#abstract
+     
+     State is double, or an Eigen column vector (fixed-size or VectorXd) for multivariate
+     targets. Vector states need a candidate with sample_block(rows, gen), such as
+     MultivariateStudentT, and densities taking Eigen vectors; a logpdf_block member lets a
+     distribution score a block of candidates at once. Vector states are scored in the
+     log domain, since their densities under- and overflow quickly with dimension
      */
-    template<typename CandidateDist, typename TargetDist>
+    template<typename CandidateDist, typename TargetDist, typename State = double>
     class IMH
     {
+    public:
+        typedef std::conditional_t<std::is_arithmetic<State>::value, IMHHistory, IMHBlockHistory> History;
+        
     protected:
-        /*
-         1.11 is default so we can check if it hasn't been initialized
-         
-         Usually, best practices would be to use boost::optional<double>
-        if you don't have C++17, or some of your program is old and
-         won't work with new std types, or std::optional<double>
-         if you're compiling with C++17 or later. For this class though, we're going
-         to use a preset value .*/
-        double lower_bound{ 1.11 };
+        State lower_bound{};
         CandidateDist Q;
         TargetDist pi;
+        /*
+         if true, histories hold log weights and acceptance is tested as
+         log(u) + log w(x) < log w(y), so weights that under- or overflow a double still compare
+         */
+        bool log_domain{ false };
+        //weight (or log weight) of lower_bound, the weight every backward search starts from
+        double lower_weight{ 0.0 };
+        
+        double history_weight(const State& x) const noexcept
+        {
+            return log_domain ? log_weight(x) : weight(x);
+        }
+        
+        int dim() const noexcept
+        {
+            if constexpr(std::is_arithmetic<State>::value){
+                return 1;
+            } else{
+                return lower_bound.size();
+            }
+        }
+        
+        /**
+         *@brief: weights for candidates [weights.size(), end) of a vector-state history, as
+         * one batch per distribution
+         */
+        void score_block(IMHBlockHistory& history, std::size_t end) const noexcept
+        {
+            std::size_t first = history.weights.size();
+            std::size_t count = end - first;
+            auto block = history.candidates.middleRows(first, count);
+            history.weights.resize(end);
+            history.scratch.resize(count);
+            Markov::log_density_block(pi, block, history.weights.data() + first, history.work);
+            Markov::log_density_block(Q, block, history.scratch.data(), history.work);
+            for(std::size_t i = 0; i < count; i++){
+                double lw = history.weights[first + i] - history.scratch[i];
+                history.weights[first + i] = log_domain ? lw : std::exp(lw);
+            }
+        }
+        
+        /**
+         *@return: state k of the history, or lower_bound for k = -1
+         */
+        State history_state(const History& history, int k) const noexcept
+        {
+            if(k < 0){
+                return lower_bound;
+            }
+            if constexpr(std::is_arithmetic<State>::value){
+                return history.candidates[k];
+            } else{
+                return history.candidates.row(k).transpose();
+            }
+        }
+        
+        bool accepts(const double u, const double wx, const double wy) const noexcept
+        {
+            return log_domain ? (std::log(u) + wx < wy) : (u * wx < wy);
+        }
 
     public:
         
-        constexpr IMH(const CandidateDist& _Q, const TargetDist& _pi,double lb) : Q(_Q), pi(_pi), lower_bound(lb) {}
+        /**
+         *@param logDomain: work with log weights; see setLogDomain
+         */
+        IMH(const CandidateDist& _Q, const TargetDist& _pi, const State& lb, bool logDomain = false) : lower_bound(lb), Q(_Q), pi(_pi), log_domain(logDomain || !std::is_arithmetic<State>::value)
+        {
+            lower_weight = history_weight(lower_bound);
+        }
+        
+        /**
+         *@brief: as above, with lower_bound found by find_lower_bound(). The search draws from
+         * this thread's default_rng(), so call seed_default_rng first if the bound, and with it
+         * every seeded sample, must reproduce. Call setLogDomain afterwards for log weights
+         */
+        IMH(const CandidateDist& _Q, const TargetDist& _pi) : Q(_Q), pi(_pi)
+        {
+            find_lower_bound();
+        }
+        
+        /**
+         *@brief: as above, with lower_bound found by find_lower_bound(gen), so a seeded engine
+         * makes the whole sampler reproducible
+         */
+        template<typename Engine, typename = typename Engine::result_type>
+        IMH(const CandidateDist& _Q, const TargetDist& _pi, Engine& gen) : Q(_Q), pi(_pi)
+        {
+            find_lower_bound(gen);
+        }
+        
+        /**
+         *@brief: switches between plain and log weights. Log weights use logpdf where the
+         * distributions define it (log(pdf) otherwise), and are the right choice for
+         * heavy-tailed targets, or whenever pi/Q can leave the range of a double. When every
+         * logpdf agrees with log(pdf) wherever the candidates fall, a given seed gives the same
+         * samples in both modes, up to rounding at the acceptance boundary
+         */
+        void setLogDomain(bool on) noexcept
+        {
+            log_domain = on || !std::is_arithmetic<State>::value;
+            lower_weight = history_weight(lower_bound);
+        }
+        bool getLogDomain() const noexcept { return log_domain; }
+        
+        /**
+         *@return: importance weight pi(x)/Q(x). The IMH acceptance probability from x to y
+         * is min(1, weight(y)/weight(x)), so one weight per candidate is all the
+         * sampler needs
+         */
+        double weight(const State& x) const noexcept
+        {
+            return pi.pdf(x)/Q.pdf(x);
+        }
         
+        /**
+         *@return: log pi(x) - log Q(x)
+         */
+        double log_weight(const State& x) const noexcept
+        {
+            return Markov::log_density(pi, x) - Markov::log_density(Q, x);
+        }
         
-        constexpr auto MH_ratio(const double x, const double y) const noexcept
+        constexpr auto MH_ratio(const State& x, const State& y) const noexcept
         {
             //std::cout << pi.pdf(y) << " " << Q.pdf(x) << "\n";
             return (pi.pdf(y)*Q.pdf(x))/(pi.pdf(x)*Q.pdf(y));
@@ -52,7 +358,7 @@ namespace Markov
          *@algorithm by Corcoran and Tweedie
          *@return: "larger" of x and y according to the partial order for perfect IMH
          */
-        constexpr auto partial_order(const double x, const double y) const noexcept
+        constexpr auto partial_order(const State& x, const State& y) const noexcept
         {
             return MH_ratio( x, y) >= 1 ? x : y;
         }
@@ -62,16 +368,91 @@ namespace Markov
          * @brief: alpha(x,y) in the paper
          *@return: min(1, MH_ratio)
          */
-        constexpr auto accceptance_threshold(const double x, const double y) const noexcept
+        constexpr auto accceptance_threshold(const State& x, const State& y) const noexcept
         {
             auto ratio = MH_ratio(x, y);
             return ratio < 1.0 ? ratio : static_cast<double>(1.0);
         }
         /**
          *@author: Zane Jakobs
-         *@brief: finds \ell from the paper, lower bound on reordered sample space
+         *@brief: finds \ell from the paper, lower bound on reordered sample space: the point
+         * where w = pi/Q is largest, since no candidate is easier to move away from. The search
+         * minimizes -log w from the best of a set of candidate draws (bracketing, then Brent),
+         * restarting from the best few well-separated draws in case w has several modes. As a
+         * safety check, the result must beat every draw, or the best draw is kept instead.
+         * The result is stored as this sampler's lower bound. 1-D states only
+         *@param gen: random engine for the candidate draws
+         *@param probes: how many candidates to draw
+         *@param tol: relative tolerance on the location of the maximum
+         *@return: the lower bound
          */
-        //constexpr auto find_lower_bound(const TargetDist& _pi) const noexcept;
+        template<typename Engine>
+        double find_lower_bound(Engine& gen, unsigned probes = 1000, double tol = 1.0e-8)
+        {
+            static_assert(std::is_arithmetic<State>::value, "find_lower_bound searches 1-D states only; pass the lower bound for vector states");
+            //outside the target's support log w is -inf (or nan where Q vanishes too)
+            auto f = [this](double x){
+                double lw = log_weight(x);
+                return std::isnan(lw) ? std::numeric_limits<double>::infinity() : -lw;
+            };
+            std::vector<double> points;
+            Q.update_sample_vector(points, probes, gen);
+            if(points.empty()){
+                throw "Error: find_lower_bound needs at least one candidate draw.";
+            }
+            std::vector<std::pair<double,double> > scored(points.size());
+            for(std::size_t i = 0; i < points.size(); i++){
+                scored[i] = std::make_pair(f(points[i]), points[i]);
+            }
+            std::sort(scored.begin(), scored.end());
+            double best = scored[0].second;
+            double fbest = scored[0].first;
+            if(!std::isfinite(fbest)){
+                throw "Error: no candidate draw has positive target density, so the IMH lower bound cannot be located.";
+            }
+            //first step: a small fraction of the draws' interquartile range
+            std::sort(points.begin(), points.end());
+            double step = 0.01*(points[3*points.size()/4] - points[points.size()/4]);
+            if(!(step > 0)){
+                step = 1.0e-3*(1.0 + std::abs(best));
+            }
+            const int starts = 3;
+            std::vector<double> tried;
+            for(std::size_t i = 0; i < scored.size() && static_cast<int>(tried.size()) < starts; i++){
+                double x0 = scored[i].second;
+                if(!std::isfinite(scored[i].first)){
+                    break;
+                }
+                bool near = false;
+                for(auto t : tried){
+                    near = near || std::abs(t - x0) < 10.0*step;
+                }
+                if(near){
+                    continue;
+                }
+                tried.push_back(x0);
+                double a = x0, b = x0 + step, c;
+                if(!bracket_minimum(f, a, b, c)){
+                    throw "Error: pi/Q appears unbounded, so perfect IMH has no lower bound with this candidate; use a candidate with heavier tails than the target.";
+                }
+                double x = brent_minimize(f, a, b, c, tol);
+                double fx = f(x);
+                if(fx < fbest){
+                    best = x;
+                    fbest = fx;
+                }
+            }
+            lower_bound = best;
+            lower_weight = history_weight(lower_bound);
+            return lower_bound;
+        }
+        
+        double find_lower_bound(unsigned probes = 1000, double tol = 1.0e-8)
+        {
+            return find_lower_bound(default_rng(), probes, tol);
+        }
+        
+        const State& getLowerBound() const noexcept { return lower_bound; }
         
         
         /**
@@ -98,61 +479,219 @@ namespace Markov
             return state;
         }
         
+        /**
+         *@brief: as above, over a history whose entry k is time -k. Uses the cached weights:
+         * u < min(1, w(y)/w(x)) is u*w(x) < w(y) since u < 1 (log(u) + log w(x) < log w(y) in
+         * the log domain), so no pdf is evaluated
+         */
+        State MH_from_past(int n, const History& history) const noexcept
+        {
+            return history_state(history, MH_from_past_index(n, history));
+        }
+        
+        /**
+         *@return: history index of the state at time 0, -1 meaning lower_bound. Tracking the
+         * index rather than the state keeps vector states from being copied on every accept
+         */
+        int MH_from_past_index(int n, const History& history) const noexcept
+        {
+            int state = -1;
+            auto w = lower_weight;
+            for(int k = n; k >= 0; k--){
+                if(accepts(history.uniforms[k], w, history.weights[k])){
+                    state = k;
+                    w = history.weights[k];
+                }
+            }
+            return state;
+        }
+        
+        /**
+         *@brief: draws another additions pairs of uniforms and candidates, further in the past
+         */
+        template<typename Engine>
+        void extend_history(History& history, unsigned additions, Engine& gen) const noexcept
+        {
+            uniform_real_distribution<double> dis(0.0,1.0);
+            std::size_t first = history.size();
+            for(unsigned i = 0; i < additions; i++){
+                history.uniforms.push_back(dis(gen));
+            }
+            if constexpr(std::is_arithmetic<State>::value){
+                Q.update_sample_vector(history.candidates, additions, gen);
+            } else{
+                history.reserve(first + additions, dim());
+                Q.sample_block(history.candidates.middleRows(first, additions), gen);
+            }
+        }
+        
+        /**
+         *@brief: the backward search of perfect IMH; see perfect_IMH_sample
+         *@return: history index of the sample, -1 meaning lower_bound
+         */
+        template<typename Engine>
+        int perfect_IMH_search(unsigned initial_len, Engine& gen, History& history) const noexcept
+        {
+            history.clear();
+            if(initial_len < 2){
+                initial_len = 2;
+            }
+            int n = 1;
+            while(true){
+                if(static_cast<std::size_t>(n) >= history.size()){
+                    extend_history(history, initial_len, gen);
+                }
+                if constexpr(std::is_arithmetic<State>::value){
+                    while(history.weights.size() <= static_cast<std::size_t>(n)){
+                        history.weights.push_back(history_weight(history.candidates[history.weights.size()]));
+                    }
+                } else if(history.weights.size() <= static_cast<std::size_t>(n)){
+                    //batches double in size, so short searches score little beyond what they use
+                    std::size_t end = std::max<std::size_t>(n + 1, 2*history.weights.size());
+                    score_block(history, std::min(end, history.size()));
+                }
+                //if the first transition from time -n is accepted, we have converged
+                if(accepts(history.uniforms[n], lower_weight, history.weights[n])){
+                    break;
+                }
+                n++;//if we reject the transition, move back one in time
+            }
+            return MH_from_past_index(n, history);
+        }
+        
+        /**
+         *@author: Zane Jakobs
+         *@brief: runs the perfect IMH algorithm once
+         *@param initial_len: how many time steps are drawn at a time as the search goes back
+         *@param gen: random engine supplying both the uniforms and the candidates
+         *@param history: overwritten; passing the same one on every call reuses its storage
+         */
+        template<typename Engine>
+        State perfect_IMH_sample(unsigned initial_len, Engine& gen, History& history) const noexcept
+        {
+            return history_state(history, perfect_IMH_search(initial_len, gen, history));
+        }
+        
         /**
          *@author: Zane Jakobs
          *@brief: runs the perfect IMH algorithm once
          */
         auto perfect_IMH_sample(unsigned initial_len, pair<default_random_engine, uniform_real_distribution<double> >& spar) const noexcept
         {
-            
-            auto avec = Markov::uniform_sample_vector(spar, initial_len);
-            auto qvec = Q.create_sample_vector(initial_len);
-            bool accepted_first = false;
-            int n = 1;
-            // #pragma omp parallel
-            while(!accepted_first){
-                //vlen is "time 0"
-                auto vlen = avec.size() - 1;
-                //update vectors if we hit the end of them
-                if(n == vlen){
-                    avec = Markov::update_uniform_sample_vector(avec, spar, initial_len);
-                    Q.update_sample_vector(qvec, initial_len);
-                    
-                    vlen += initial_len;
-                }/*
-                    std::cout << "Large n, printing qvec[vlen-n] \n";
-                    std::cout << qvec[vlen-n] << "\n";
-                    std::cout << "Printing acceptance_threshold\n";
-                    std::cout << accceptance_threshold(lower_bound, qvec[vlen - n]);*/
-                auto threshold = accceptance_threshold(lower_bound, qvec[vlen - n]);
-                
-                //if the first transition from time -n is accepted, we have converged
-                if(avec[vlen - n] < threshold ){
-                    accepted_first = true;
-                    //std::cout << n <<"\n";
+            History history;
+            return perfect_IMH_sample(initial_len, spar.first, history);
+        }
+        
+        /**
+         *@brief: draws `samples` perfect samples on numThreads threads (0 for the OpenMP
+         * default). For a given lower bound, the output depends only on seed, never on the
+         * thread count or schedule
+         */
+        auto perfect_IMH_sample_vector(unsigned samples, unsigned initial_len, uint64_t seed, int numThreads = 0) const noexcept
+        {
+            vector<State> sampleContainer(samples);
+            parallel_samples(0, samples, initial_len, seed, numThreads, [&](int i, const History& history, int k){
+                sampleContainer[i] = history_state(history, k);
+            });
+            return sampleContainer;
+        }
+        
+        /**
+         *@brief: as perfect_IMH_sample_vector, for vector states: row i of the result is
+         * sample i, copied straight out of the history with no per-sample allocation
+         */
+        Eigen::MatrixXd perfect_IMH_sample_matrix(unsigned samples, unsigned initial_len, uint64_t seed, int numThreads = 0) const noexcept
+        {
+            static_assert(!std::is_arithmetic<State>::value, "perfect_IMH_sample_matrix is for vector states; use perfect_IMH_sample_vector");
+            Eigen::MatrixXd out(samples, dim());
+            parallel_samples(0, samples, initial_len, seed, numThreads, [&](int i, const History& history, int k){
+                if(k < 0){
+                    out.row(i) = lower_bound.transpose();
                 } else{
-                    n++;//if we reject the transition, move back one in time
+                    out.row(i) = history.candidates.row(k);
                 }
-            }//end while
-            auto sample = MH_from_past(n, qvec, avec);
-            return sample;
+            });
+            return out;
         }
-        auto perfect_IMH_sample_vector(unsigned samples, unsigned initial_len = 100) const noexcept
+        
+        /**
+         *@brief: streams perfect samples to sink(i, x) in order, until sink returns false
+         * (a ChainMonitor at its target ESS, say) or maxSamples have been drawn. Samples are
+         * drawn in parallel rounds, and sample i is the same as sample i of
+         * perfect_IMH_sample_vector with the same seed
+         *@return: number of samples passed to the sink
+         */
+        template<typename Sink>
+        unsigned perfect_IMH_stream(Sink&& sink, unsigned maxSamples, unsigned initial_len, uint64_t seed, int numThreads = 0) const
         {
-            auto sampler  = std_sampler_pair();
-            vector<double> sampleContainer(samples);
-            
-            
-           // #pragma omp parallel num_threads(4)
-            //{
-            //        #pragma omp for
-                for(int i = 0; i < samples; i++){
-                    sampleContainer[i] = perfect_IMH_sample(initial_len, sampler);
+            int threads = 1;
+#ifdef _OPENMP
+            threads = (numThreads > 0) ? numThreads : omp_get_max_threads();
+#endif
+            //a few blocks per thread per round keeps the threads busy without overshooting far
+            const unsigned round = 4*64*threads;
+            vector<State> buffer(std::min(round, maxSamples));
+            unsigned done = 0;
+            while(done < maxSamples){
+                unsigned end = std::min(maxSamples, done + round);
+                parallel_samples(done, end, initial_len, seed, threads, [&](int i, const History& history, int k){
+                    buffer[i - done] = history_state(history, k);
+                });
+                for(unsigned i = done; i < end; i++){
+                    if(!call_sink(sink, i, buffer[i - done])){
+                        return i + 1;
+                    }
                 }
-           // }
-            return sampleContainer;
+                done = end;
+            }
+            return done;
+        }
+        
+    protected:
+        /**
+         *@brief: runs the searches for samples [begin, end) on numThreads threads (0 for the
+         * OpenMP default), calling store(i, history, k) for sample i. Samples are handed out in
+         * blocks of 64, and block b draws from the stream RNG(seed, b), so the output
+         * depends only on seed, never on the thread count or schedule. begin must be a
+         * multiple of 64
+         */
+        template<typename Store>
+        void parallel_samples(unsigned begin, unsigned end, unsigned initial_len, uint64_t seed, int numThreads, Store&& store) const noexcept
+        {
+            const int block = 64;
+            int firstBlock = begin/block;
+            int numBlocks = (static_cast<int>(end) + block - 1)/block;
+            int threads = 1;
+#ifdef _OPENMP
+            threads = (numThreads > 0) ? numThreads : omp_get_max_threads();
+#endif
+            #pragma omp parallel num_threads(threads)
+            {
+                //per-thread history, reused for every sample the thread draws
+                History history;
+                #pragma omp for schedule(dynamic)
+                for(int b = firstBlock; b < numBlocks; b++){
+                    RNG gen(seed, b);
+                    int last = std::min(static_cast<int>(end), (b+1)*block);
+                    for(int i = b*block; i < last; i++){
+                        store(i, history, perfect_IMH_search(initial_len, gen, history));
+                    }
+                }
+            }
+        }
+        
+    public:
+        
+        auto perfect_IMH_sample_vector(unsigned samples, unsigned initial_len = 100) const noexcept
+        {
+            return perfect_IMH_sample_vector(samples, initial_len, default_rng()());
         }
     };
     
+    //a scalar lower bound of any arithmetic type means a double state
+    template<typename CandidateDist, typename TargetDist, typename LowerBound>
+    IMH(const CandidateDist&, const TargetDist&, const LowerBound&, bool = false)
+    -> IMH<CandidateDist, TargetDist, std::conditional_t<std::is_arithmetic<LowerBound>::value, double, LowerBound> >;
+    
 }//end namespace scope
 #endif /* MetropolisHastings_hpp */
@@ -0,0 +1,332 @@
+/**
+ * @summary : implementation of the lockstep batch stepper.
+ * Note that any individual functions not written by the author here have source links in the comments above the declaration
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+#ifdef Success
+#undef Success
+#endif
+#include"../include/BatchStepper.h"
+#include<vector>
+#include<random>
+#include<cstring>
+#include<algorithm>
+#include<Eigen/Core>
+#include<mkl.h>
+#include"../include/AliasTable.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include<immintrin.h>
+#define MARKOV_BATCH_X86
+#endif
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    namespace
+    {
+        inline uint64_t rotl(uint64_t x, int k) noexcept
+        {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        /**
+         * @summary: one xoshiro256+ draw turned into a uniform on [0,1). The top 52 bits become
+         * the mantissa of a double in [1,2), which is exact and has a direct SIMD equivalent
+         * @source: Blackman and Vigna, http://prng.di.unimi.it/xoshiro256plus.c
+         */
+        inline double next_uniform(uint64_t& s0, uint64_t& s1, uint64_t& s2, uint64_t& s3) noexcept
+        {
+            uint64_t result = s0 + s3;
+            uint64_t t = s1 << 17;
+            s2 ^= s0;
+            s3 ^= s1;
+            s1 ^= s2;
+            s0 ^= s3;
+            s2 ^= t;
+            s3 = rotl(s3, 45);
+            uint64_t bits = (result >> 12) | 0x3FF0000000000000ULL;
+            double u;
+            std::memcpy(&u, &bits, sizeof(u));
+            return u - 1.0;
+        }
+
+        void step_scalar(const double* prob, const int32_t* alias, int n, int32_t* states,
+                         uint64_t* s0, uint64_t* s1, uint64_t* s2, uint64_t* s3, int walkers, int steps) noexcept
+        {
+            const double nd = n;
+            for(int w = 0; w < walkers; w++){
+                uint64_t a = s0[w], b = s1[w], c = s2[w], d = s3[w];
+                int32_t st = states[w];
+                for(int t = 0; t < steps; t++){
+                    double x = next_uniform(a, b, c, d) * nd;
+                    int32_t col = std::min(static_cast<int32_t>(x), n - 1);
+                    double frac = x - col;
+                    int32_t idx = st * n + col;
+                    st = (frac < prob[idx]) ? col : alias[idx];
+                }
+                states[w] = st;
+                s0[w] = a; s1[w] = b; s2[w] = c; s3[w] = d;
+            }
+        }
+
+#ifdef MARKOV_BATCH_X86
+        //8 walkers per iteration, as two halves of 4 (a __m256d holds 4 uniforms)
+        __attribute__((target("avx2")))
+        void step_avx2(const double* prob, const int32_t* alias, int n, int32_t* states,
+                       uint64_t* s0, uint64_t* s1, uint64_t* s2, uint64_t* s3, int walkers, int steps) noexcept
+        {
+            const __m256i oneBits = _mm256_set1_epi64x(0x3FF0000000000000LL);
+            const __m256d one = _mm256_set1_pd(1.0);
+            const __m256d nd = _mm256_set1_pd(static_cast<double>(n));
+            const __m128i nv = _mm_set1_epi32(n);
+            const __m128i nm1 = _mm_set1_epi32(n - 1);
+            const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+            //masked gathers with an explicit zero source: the unmasked forms read an
+            //uninitialized source register as far as the compiler can tell
+            const __m256d allLanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            const __m128i allLanes32 = _mm_set1_epi32(-1);
+            for(int w = 0; w < walkers; w += 8){
+                __m256i a[2], b[2], c[2], d[2];
+                __m128i st[2];
+                for(int h = 0; h < 2; h++){
+                    int o = w + 4*h;
+                    a[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s0 + o));
+                    b[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s1 + o));
+                    c[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s2 + o));
+                    d[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s3 + o));
+                    st[h] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(states + o));
+                }
+                for(int t = 0; t < steps; t++){
+                    for(int h = 0; h < 2; h++){
+                        __m256i result = _mm256_add_epi64(a[h], d[h]);
+                        __m256i tt = _mm256_slli_epi64(b[h], 17);
+                        c[h] = _mm256_xor_si256(c[h], a[h]);
+                        d[h] = _mm256_xor_si256(d[h], b[h]);
+                        b[h] = _mm256_xor_si256(b[h], c[h]);
+                        a[h] = _mm256_xor_si256(a[h], d[h]);
+                        c[h] = _mm256_xor_si256(c[h], tt);
+                        d[h] = _mm256_or_si256(_mm256_slli_epi64(d[h], 45), _mm256_srli_epi64(d[h], 19));
+
+                        __m256d u = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(result, 12), oneBits)), one);
+                        __m256d x = _mm256_mul_pd(u, nd);
+                        __m128i col = _mm_min_epi32(_mm256_cvttpd_epi32(x), nm1);
+                        __m256d frac = _mm256_sub_pd(x, _mm256_cvtepi32_pd(col));
+                        __m128i idx = _mm_add_epi32(_mm_mullo_epi32(st[h], nv), col);
+                        __m256d p = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), prob, idx, allLanes, 8);
+                        __m128i al = _mm_mask_i32gather_epi32(_mm_setzero_si128(), alias, idx, allLanes32, 4);
+                        //4 x 64-bit compare mask down to 4 x 32 bits
+                        __m256i keep64 = _mm256_castpd_si256(_mm256_cmp_pd(frac, p, _CMP_LT_OQ));
+                        __m128i keep = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(keep64, pack));
+                        st[h] = _mm_blendv_epi8(al, col, keep);
+                    }
+                }
+                for(int h = 0; h < 2; h++){
+                    int o = w + 4*h;
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s0 + o), a[h]);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s1 + o), b[h]);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s2 + o), c[h]);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s3 + o), d[h]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(states + o), st[h]);
+                }
+            }
+        }
+
+        /**
+         * @summary: zero-extends 8 int32 lanes to 512 bits, and back. Here and below, the AVX-512
+         * operations use their zero-masked forms with every lane enabled: GCC implements the
+         * unmasked ones, _mm512_zextsi256_si512 and the 512 to 256-bit cast included, on an
+         * undefined source register, which -Wall reports as maybe-uninitialized
+         */
+        __attribute__((target("avx512f")))
+        inline __m512i widen(__m256i x) noexcept
+        {
+            return _mm512_maskz_inserti64x4(0xFF, _mm512_setzero_si512(), x, 0);
+        }
+
+        __attribute__((target("avx512f")))
+        inline __m256i narrow(__m512i x) noexcept
+        {
+            return _mm512_maskz_extracti64x4_epi64(0xF, x, 0);
+        }
+
+        //16 walkers per iteration, as two halves of 8
+        __attribute__((target("avx512f")))
+        void step_avx512(const double* prob, const int32_t* alias, int n, int32_t* states,
+                         uint64_t* s0, uint64_t* s1, uint64_t* s2, uint64_t* s3, int walkers, int steps) noexcept
+        {
+            const __m512i oneBits = _mm512_set1_epi64(0x3FF0000000000000LL);
+            const __m512d one = _mm512_set1_pd(1.0);
+            const __m512d nd = _mm512_set1_pd(static_cast<double>(n));
+            const __m256i nv = _mm256_set1_epi32(n);
+            const __m256i nm1 = _mm256_set1_epi32(n - 1);
+            const __m256i allLanes32 = _mm256_set1_epi32(-1);
+            for(int w = 0; w < walkers; w += 16){
+                __m512i a[2], b[2], c[2], d[2];
+                __m256i st[2];
+                for(int h = 0; h < 2; h++){
+                    int o = w + 8*h;
+                    a[h] = _mm512_loadu_si512(s0 + o);
+                    b[h] = _mm512_loadu_si512(s1 + o);
+                    c[h] = _mm512_loadu_si512(s2 + o);
+                    d[h] = _mm512_loadu_si512(s3 + o);
+                    st[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + o));
+                }
+                for(int t = 0; t < steps; t++){
+                    for(int h = 0; h < 2; h++){
+                        __m512i result = _mm512_add_epi64(a[h], d[h]);
+                        __m512i tt = _mm512_maskz_slli_epi64(0xFF, b[h], 17);
+                        c[h] = _mm512_xor_si512(c[h], a[h]);
+                        d[h] = _mm512_xor_si512(d[h], b[h]);
+                        b[h] = _mm512_xor_si512(b[h], c[h]);
+                        a[h] = _mm512_xor_si512(a[h], d[h]);
+                        c[h] = _mm512_xor_si512(c[h], tt);
+                        d[h] = _mm512_maskz_rol_epi64(0xFF, d[h], 45);
+
+                        __m512d u = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_maskz_srli_epi64(0xFF, result, 12), oneBits)), one);
+                        __m512d x = _mm512_mul_pd(u, nd);
+                        __m256i col = _mm256_min_epi32(_mm512_maskz_cvttpd_epi32(0xFF, x), nm1);
+                        __m512d frac = _mm512_sub_pd(x, _mm512_maskz_cvtepi32_pd(0xFF, col));
+                        __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(st[h], nv), col);
+                        __m512d p = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, idx, prob, 8);
+                        __m256i al = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), alias, idx, allLanes32, 4);
+                        __mmask8 keep = _mm512_cmp_pd_mask(frac, p, _CMP_LT_OQ);
+                        st[h] = narrow(_mm512_mask_blend_epi32(static_cast<__mmask16>(keep), widen(al), widen(col)));
+                    }
+                }
+                for(int h = 0; h < 2; h++){
+                    int o = w + 8*h;
+                    _mm512_storeu_si512(s0 + o, a[h]);
+                    _mm512_storeu_si512(s1 + o, b[h]);
+                    _mm512_storeu_si512(s2 + o, c[h]);
+                    _mm512_storeu_si512(s3 + o, d[h]);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(states + o), st[h]);
+                }
+            }
+        }
+#endif
+    }
+
+    //walkers are padded to a multiple of the widest kernel's block; padding walkers sit in state 0
+    const int batch_block = 16;
+
+    BatchStepper::BatchStepper(const Eigen::MatrixXd& transition, int walkers, uint64_t seed){
+        buildTables(transition);
+        numWalkers = walkers;
+        paddedWalkers = ((walkers + batch_block - 1)/batch_block) * batch_block;
+        _states.assign(paddedWalkers, 0);
+        this->seed(seed);
+        kernel = detectKernel();
+    }
+
+    BatchStepper::BatchStepper(const MarkovChain& mc, int walkers, uint64_t seed) : BatchStepper(mc.getTransition(), walkers, seed){
+        Eigen::MatrixXd init = mc.getInit();
+        if(init.cols() != numStates){
+            return;
+        }
+        AliasTable initTable(init.row(0).eval().data(), numStates);
+        for(int w = 0; w < numWalkers; w++){
+            _states[w] = initTable.sample(next_uniform(_s0[w], _s1[w], _s2[w], _s3[w]));
+        }
+    }
+
+    BatchStepper::BatchStepper(const MarkovChain& mc, int walkers, RNG& rng) : BatchStepper(mc, walkers, rng()) {}
+
+    BatchStepper::BatchStepper(const MarkovChain& mc, int walkers) : BatchStepper(mc, walkers, default_rng()()) {}
+
+    void BatchStepper::buildTables(const Eigen::MatrixXd& transition){
+        numStates = transition.cols();
+        //flat indices state * N + column are 32-bit, as the gathers take int32 offsets
+        if(static_cast<int64_t>(numStates) * numStates > INT32_MAX){
+            throw "Error: too many states for BatchStepper.";
+        }
+        _prob.resize(static_cast<size_t>(numStates) * numStates);
+        _alias.resize(static_cast<size_t>(numStates) * numStates);
+        Eigen::RowVectorXd row(numStates);
+        for(int i = 0; i < numStates; i++){
+            row = transition.row(i);
+            AliasTable table(row.data(), numStates);
+            std::copy(table.prob.begin(), table.prob.end(), _prob.begin() + static_cast<size_t>(i) * numStates);
+            std::copy(table.alias.begin(), table.alias.end(), _alias.begin() + static_cast<size_t>(i) * numStates);
+        }
+    }
+
+    void BatchStepper::seed(uint64_t seed){
+        _s0.resize(paddedWalkers);
+        _s1.resize(paddedWalkers);
+        _s2.resize(paddedWalkers);
+        _s3.resize(paddedWalkers);
+        uint64_t x = seed;
+        for(int w = 0; w < paddedWalkers; w++){
+            _s0[w] = splitmix64(x);
+            _s1[w] = splitmix64(x);
+            _s2[w] = splitmix64(x);
+            _s3[w] = splitmix64(x);
+        }
+    }
+
+    BatchStepper::Kernel BatchStepper::detectKernel() noexcept{
+#ifdef MARKOV_BATCH_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")){
+            return AVX512;
+        }
+        if(__builtin_cpu_supports("avx2")){
+            return AVX2;
+        }
+#endif
+        return SCALAR;
+    }
+
+    void BatchStepper::setKernel(Kernel k){
+        if(k > detectKernel()){
+            throw "Error: kernel not supported on this CPU.";
+        }
+        kernel = k;
+    }
+
+    /**
+     * @name BatchStepper::step
+     * @param steps: number of transitions
+     */
+    void BatchStepper::step(int steps) noexcept{
+        if(steps <= 0 || numWalkers == 0){
+            return;
+        }
+        switch(kernel){
+#ifdef MARKOV_BATCH_X86
+            case AVX512:
+                step_avx512(_prob.data(), _alias.data(), numStates, _states.data(),
+                            _s0.data(), _s1.data(), _s2.data(), _s3.data(), paddedWalkers, steps);
+                break;
+            case AVX2:
+                step_avx2(_prob.data(), _alias.data(), numStates, _states.data(),
+                          _s0.data(), _s1.data(), _s2.data(), _s3.data(), paddedWalkers, steps);
+                break;
+#endif
+            default:
+                step_scalar(_prob.data(), _alias.data(), numStates, _states.data(),
+                            _s0.data(), _s1.data(), _s2.data(), _s3.data(), numWalkers, steps);
+        }
+    }
+
+    void BatchStepper::setStates(const std::vector<int>& states){
+        if(static_cast<int>(states.size()) != numWalkers){
+            throw "Error: need one state per walker.";
+        }
+        std::copy(states.begin(), states.end(), _states.begin());
+    }
+
+    std::vector<int> BatchStepper::getStates() const{
+        return std::vector<int>(_states.begin(), _states.begin() + numWalkers);
+    }
+
+    std::vector<int> BatchStepper::stateCounts() const{
+        std::vector<int> counts(numStates, 0);
+        for(int w = 0; w < numWalkers; w++){
+            counts[_states[w]]++;
+        }
+        return counts;
+    }
+}
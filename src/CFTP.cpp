@@ -16,7 +16,13 @@
 #include<mkl.h>
 #include<complex>
 #include<utility>
+#include<tuple>
+#include<vector>
+#include<cstdint>
 #include "../include/MarkovFunctions.h"
+#ifdef _OPENMP
+#include<omp.h>
+#endif
 using namespace std;
 using namespace Eigen;
 using namespace Markov;
@@ -105,128 +111,473 @@ int mixing_time(const Eigen::MatrixXd &trans){
     }
     return -1; //in case of failure
 }
-//takes in matrix where elements are states in voter CFTP
-int isCoalesced(const Eigen::MatrixXd &mat){
-    int nrows = mat.rows();
-    int sample  = mat(0,0);
-    for(int i = 1; i < nrows; i++){
-        if(mat(i,0) != sample){
-            return -1;
+void CFTPBatchStats::add(const CFTPStats& run){
+    samples++;
+    if(run.horizon < 0){
+        failures++;
+    }
+    else{
+        int k = 0;
+        while((2L << k) <= run.horizon){
+            k++;
+        }
+        if(static_cast<int>(horizonHistogram.size()) <= k){
+            horizonHistogram.resize(k+1, 0);
         }
+        horizonHistogram[k]++;
+        maxHorizon = std::max(maxHorizon, run.horizon);
+    }
+    int k = 0;
+    for(double us = run.seconds * 1.0e6; us >= 1.0; us /= 2){
+        k++;
+    }
+    if(static_cast<int>(timeHistogram.size()) <= k){
+        timeHistogram.resize(k+1, 0);
+    }
+    timeHistogram[k]++;
+    uniforms += run.uniforms;
+    peakBytes = std::max(peakBytes, run.peakBytes);
+    seconds += run.seconds;
+    maxSeconds = std::max(maxSeconds, run.seconds);
+}
+
+void CFTPBatchStats::merge(const CFTPBatchStats& other){
+    samples += other.samples;
+    failures += other.failures;
+    uniforms += other.uniforms;
+    peakBytes = std::max(peakBytes, other.peakBytes);
+    seconds += other.seconds;
+    maxSeconds = std::max(maxSeconds, other.maxSeconds);
+    maxHorizon = std::max(maxHorizon, other.maxHorizon);
+    if(horizonHistogram.size() < other.horizonHistogram.size()){
+        horizonHistogram.resize(other.horizonHistogram.size(), 0);
+    }
+    for(size_t k = 0; k < other.horizonHistogram.size(); k++){
+        horizonHistogram[k] += other.horizonHistogram[k];
+    }
+    if(timeHistogram.size() < other.timeHistogram.size()){
+        timeHistogram.resize(other.timeHistogram.size(), 0);
+    }
+    for(size_t k = 0; k < other.timeHistogram.size(); k++){
+        timeHistogram[k] += other.timeHistogram[k];
+    }
+}
+
+void CFTPEngine::report(CFTPStats* stats, std::chrono::steady_clock::time_point start) const{
+    if(!stats){
+        return;
+    }
+    stats->horizon = horizon;
+    stats->uniforms = _uniforms.size();
+    stats->peakBytes = _uniforms.capacity() * sizeof(double) + _images.bytes() + _distinct.capacity() * sizeof(int);
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats->distinctCounts = _distinct;
+}
+
+/**
+ * @name CFTPEngine::run
+ * @param T: horizon
+ * @return: common state at time 0, or -1
+ */
+int CFTPEngine::run(int T) noexcept{
+    _images.reset(nStates);
+    _distinct.clear();
+    int k = T-1;
+    for(; k >= 0 && !_images.coalesced(); k--){
+        double u = _uniforms[k];
+        _images.step([this, u](int x){ return update(x, u); });
+        _distinct.push_back(_images.size());
+    }
+    if(!_images.coalesced()){
+        return -1;
+    }
+    //one trajectory left; finish it to time 0
+    int sample = _images.states[0];
+    for(; k >= 0; k--){
+        sample = update(sample, _uniforms[k]);
     }
     return sample;
 }
-   
 
 /**
  * @author: Zane Jakobs
  * @summary: voter CFTP algorithm to perfectly sample from the Markov chain with transition matrix mat. Algorithm from https://pdfs.semanticscholar.org/ef02/fd2d2b4d0a914eba5e4270be4161bcae8f81.pdf
  * @return: perfect sample from matrix's distribution
  */
-int voter_CFTP(const Eigen::MatrixXd &mat){
-    
-    int nStates = mat.cols();
-    
-    std::deque<double> R; //random samples
-    
-    int colCount = 1;
-    
-    const int max_cols = 100;
-    //initialize M with 100 columns
-    Eigen::MatrixXd M(nStates,max_cols);
-    
-    for(int i = 0; i < nStates; i++){
-        M(i,0) = i;
-    }
-    //set random seed
-    random_device rd;
-    //init Mersenne Twistor
-    minstd_rand gen(rd());
-    // unif(0,1)
-    uniform_real_distribution<> dis(0.0,1.0);
-    
-    
-    bool coalesced = false;
-    while(not coalesced and colCount < max_cols){
-        
-        
-        double r = dis(gen);
-        
-        R.push_front(r); // R(T) ~ U(0,1)
-        //T -= 1, starting at T = 0 above while loop;
-        colCount++;
-        //move every element one to the right
-        for(int i = colCount-1; i > 0; i--){
-            Eigen::MatrixXd temp = M.col(i-1);
-            M.col(i) = temp;
-               
+template<typename Scalar>
+int voter_CFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, RNG& rng){
+    CFTPEngine engine(mat);
+    return engine.sample(rng);
+}
+
+template<typename Scalar>
+int voter_CFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat){
+    return voter_CFTP(mat, default_rng());
+}
+
+
+ReadOnceCFTP::ReadOnceCFTP(const Eigen::MatrixXd& mat, uint64_t seed, int blockLength, int maxBlockLength)
+: _engine(mat), nStates(mat.cols()), blockLength(blockLength), dis(0.0,1.0){
+    gen.seed(seed);
+    if(blockLength <= 0){
+        tuneBlockLength(maxBlockLength);
+    }
+}
+
+bool ReadOnceCFTP::block(int& x){
+    _images.reset(nStates);
+    int t = 0;
+    for(; t < blockLength && !_images.coalesced(); t++){
+        double u = dis(gen);
+        _images.step([this, u](int y){ return _engine.update(y, u); });
+        if(x >= 0){
+            x = _engine.update(x, u);
         }
-        //reinitialize first column
-        for(int i = 0; i < nStates; i++){
-            int randState = random_transition(mat, nStates, i,r);
-            M(i,0) = M(randState,1);
+    }
+    if(!_images.coalesced()){
+        return false;
+    }
+    //x, if tracked, is now the one remaining image; the block still uses all its uniforms
+    int y = _images.states[0];
+    for(; t < blockLength; t++){
+        y = _engine.update(y, dis(gen));
+    }
+    blockValue = y;
+    if(x >= 0){
+        x = y;
+    }
+    return true;
+}
+
+void ReadOnceCFTP::tuneBlockLength(int maxBlockLength){
+    const int trials = 16;
+    int x = -1;
+    for(blockLength = 1; blockLength <= maxBlockLength; blockLength *= 2){
+        int hits = 0;
+        for(int k = 0; k < trials; k++){
+            hits += block(x);
         }
-        int sample = isCoalesced(M);
-        if(sample != -1){
-            coalesced = true;
-            return sample;
+        if(2*hits >= trials){
+            return;
         }
     }
-    return -1;
+    throw "Error: chain does not coalesce within the maximum block length.";
 }
 
 /**
- *@author: Zane Jakobs
- * @param trans: transition matrix
- * @param gen, dis: random number generator stuff
- * @param mat: transition matrix
- * @param R: deque to hold random numbers
- * @param M: matrix to represent voter CFTP process
- * @param nStates: how many states?
- * @param coalesced: has the chain coalesced?
- * @return: distribution
+ * @name ReadOnceCFTP::next
+ * @return: next perfect sample
  */
-int iteratedVoterCFTP(std::mt19937 &gen, std::uniform_real_distribution<> &dis,
-                      const Eigen::MatrixXd &mat, std::deque<double> &R,
-                      Eigen::MatrixXd &M, Eigen::MatrixXd &temp, const int &nStates,
-                      bool coalesced = false){
-        //resize M
-        M.resize(nStates,15);
-        //clear R
-        R.clear();
-    
-    //int count = 0;//how many times have we iterated?
-        for(int i = 0; i < nStates; i++){
-            M(i,0) = i;
+int ReadOnceCFTP::next(CFTPStats* stats){
+    auto start = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    long blocks = 0;
+    int x = -1;
+    //the first call has to find a coalescent block to start from
+    while(pending == -1){
+        blocks++;
+        if(block(x)){
+            pending = blockValue;
         }
-        while(not coalesced){
-            
-            double r = dis(gen);
-            
-            R.push_front(r); // R(T) ~ U(0,1)
-            //T -= 1, starting at T = 0 above while loop;
-            M.conservativeResize(M.rows(), M.cols()+1);
-            //move every element one to the right
-            for(int i = M.cols()-1; i > 0; i--){
-                temp = M.col(i-1);
-                M.col(i) = temp;
-                
+    }
+    x = pending;
+    int before;
+    do{
+        before = x;
+        blocks++;
+    }while(!block(x));
+    //the sample is the state just before the coalescent block
+    pending = blockValue;
+    if(stats){
+        long steps = blocks * blockLength;
+        stats->horizon = static_cast<int>(std::min<long>(steps, std::numeric_limits<int>::max()));
+        stats->uniforms = steps;
+        stats->peakBytes = _images.bytes();
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->distinctCounts.clear();
+    }
+    return before;
+}
+
+std::vector<int> ReadOnceCFTP::next(int count){
+    std::vector<int> samples(count);
+    for(auto& x : samples){
+        x = next();
+    }
+    return samples;
+}
+
+BoundingChainCFTP::BoundingChainCFTP(const Eigen::SparseMatrix<double, Eigen::RowMajor>& mat, int maxTracked, int maxHorizon)
+: nStates(mat.rows()), maxTracked(maxTracked > 0 ? maxTracked : mat.rows()), maxHorizon(maxHorizon){
+    _outer.assign(nStates + 1, 0);
+    _col.reserve(mat.nonZeros());
+    _cum.reserve(mat.nonZeros());
+    //(column, start, end) of every row's u-interval
+    std::vector<std::tuple<int,double,double> > raw;
+    raw.reserve(mat.nonZeros());
+    for(int i = 0; i < nStates; i++){
+        double prev = 0;
+        for(Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(mat, i); it; ++it){
+            if(it.value() <= 0){
+                continue;
             }
-            //reinitialize first column
-            int randState;
-            for(int i = 0; i < nStates; i++){
-                randState = random_transition(mat, nStates, i,r);
-                M(i,0) = M(randState,1);
+            double c = prev + it.value();
+            _col.push_back(it.col());
+            _cum.push_back(c);
+            raw.emplace_back(it.col(), prev, c);
+            prev = c;
+        }
+        if(static_cast<int>(_col.size()) == _outer[i]){
+            throw "Error: transition matrix has a row with no nonzero entries.";
+        }
+        //update clamps u past the row sum to the last entry, so its interval is open-ended
+        std::get<2>(raw.back()) = 2.0;
+        _outer[i+1] = _col.size();
+    }
+
+    //merge each column's intervals
+    std::sort(raw.begin(), raw.end());
+    for(size_t k = 0; k < raw.size(); ){
+        int j = std::get<0>(raw[k]);
+        double start = std::get<1>(raw[k]);
+        double end = std::get<2>(raw[k]);
+        for(k++; k < raw.size() && std::get<0>(raw[k]) == j && std::get<1>(raw[k]) <= end; k++){
+            end = std::max(end, std::get<2>(raw[k]));
+        }
+        _ivCol.push_back(j);
+        _ivStart.push_back(start);
+        _ivEnd.push_back(end);
+    }
+    std::vector<int> ids(_ivCol.size());
+    for(std::size_t k = 0; k < ids.size(); k++){
+        ids[k] = k;
+    }
+    _byStart.reserve(ids.size());
+    _byEnd.reserve(ids.size());
+    root = buildTree(ids);
+    _bits.assign((nStates + 63)/64, 0);
+}
+
+/**
+ * @summary: centered interval tree; the node's center is the median interval midpoint, so
+ * the depth is O(log M) and every node holds at least the median interval
+ * @param ids: intervals to place
+ * @return: node index, -1 if ids is empty
+ */
+int BoundingChainCFTP::buildTree(std::vector<int>& ids){
+    if(ids.empty()){
+        return -1;
+    }
+    std::vector<double> mids(ids.size());
+    for(std::size_t k = 0; k < ids.size(); k++){
+        mids[k] = 0.5 * (_ivStart[ids[k]] + std::min(_ivEnd[ids[k]], 1.0));
+    }
+    std::nth_element(mids.begin(), mids.begin() + mids.size()/2, mids.end());
+    double center = mids[mids.size()/2];
+
+    std::vector<int> left, right;
+    int begin = _byStart.size();
+    for(auto k : ids){
+        if(_ivEnd[k] < center){
+            left.push_back(k);
+        }
+        else if(_ivStart[k] >= center){
+            right.push_back(k);
+        }
+        else{
+            _byStart.push_back(k);
+            _byEnd.push_back(k);
+        }
+    }
+    int end = _byStart.size();
+    std::sort(_byStart.begin() + begin, _byStart.end(), [this](int a, int b){ return _ivStart[a] < _ivStart[b]; });
+    std::sort(_byEnd.begin() + begin, _byEnd.end(), [this](int a, int b){ return _ivEnd[a] > _ivEnd[b]; });
+    std::vector<int>().swap(ids);
+
+    int node = _nodes.size();
+    _nodes.push_back(IntervalNode{center, -1, -1, begin, end});
+    int l = buildTree(left);
+    int r = buildTree(right);
+    _nodes[node].left = l;
+    _nodes[node].right = r;
+    return node;
+}
+
+bool BoundingChainCFTP::stab(double u){
+    _bound.clear();
+    int node = root;
+    while(node != -1){
+        const IntervalNode& nd = _nodes[node];
+        if(u <= nd.center){
+            //every interval here ends at or after center, so it contains u iff it starts before u
+            for(int k = nd.begin; k < nd.end && _ivStart[_byStart[k]] < u; k++){
+                if(static_cast<int>(_bound.size()) == maxTracked){
+                    return false;
+                }
+                _bound.push_back(_ivCol[_byStart[k]]);
             }
-            int sample = isCoalesced(M);
-            if(sample != -1){
-                return sample;
-                coalesced = true;
+            node = nd.left;
+        }
+        else{
+            for(int k = nd.begin; k < nd.end && _ivEnd[_byEnd[k]] >= u; k++){
+                if(static_cast<int>(_bound.size()) == maxTracked){
+                    return false;
+                }
+                _bound.push_back(_ivCol[_byEnd[k]]);
             }
+            node = nd.right;
+        }
+    }
+    //a column's merged intervals are disjoint, so no column was reported twice
+    return true;
+}
+
+void BoundingChainCFTP::mapBound(double u){
+    _scratch.clear();
+    for(auto x : _bound){
+        int y = update(x, u);
+        uint64_t bit = uint64_t(1) << (y & 63);
+        if(!(_bits[y >> 6] & bit)){
+            _bits[y >> 6] |= bit;
+            _scratch.push_back(y);
         }
+    }
+    for(auto y : _scratch){
+        _bits[y >> 6] &= ~(uint64_t(1) << (y & 63));
+    }
+    _bound.swap(_scratch);
+}
+
+void BoundingChainCFTP::report(CFTPStats* stats, std::chrono::steady_clock::time_point start) const{
+    if(!stats){
+        return;
+    }
+    stats->horizon = horizon;
+    stats->uniforms = _uniforms.size();
+    stats->peakBytes = _uniforms.capacity() * sizeof(double) + (_bound.capacity() + _scratch.capacity() + _distinct.capacity()) * sizeof(int)
+                       + _bits.capacity() * sizeof(uint64_t);
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats->distinctCounts = _distinct;
+}
+
+/**
+ * @name BoundingChainCFTP::run
+ * @param T: horizon
+ * @return: the state at time 0 if the bound has shrunk to one state, -1 otherwise
+ */
+int BoundingChainCFTP::run(int T){
+    bool top = true;
+    _distinct.clear();
+    int k = T-1;
+    for(; k >= 0; k--){
+        double u = _uniforms[k];
+        if(top){
+            top = !stab(u);
+        }
+        else{
+            mapBound(u);
+        }
+        _distinct.push_back(top ? nStates : static_cast<int>(_bound.size()));
+        if(!top && _bound.size() == 1){
+            k--;
+            break;
+        }
+    }
+    if(top || _bound.size() != 1){
         return -1;
+    }
+    int sample = _bound[0];
+    for(; k >= 0; k--){
+        sample = update(sample, _uniforms[k]);
+    }
+    return sample;
 }
 
+FillSampler::FillSampler(const MarkovChain& mc, int z) : FillSampler(mc.getTransition(), mc.stationaryDistribution(), z) {}
+
+FillSampler::FillSampler(const Eigen::MatrixXd& P, const Eigen::MatrixXd& pi, int z) : _engine(P), nStates(P.cols()), z(z){
+    buildReversal(P, pi);
+}
+
+void FillSampler::buildReversal(const Eigen::MatrixXd& P, const Eigen::MatrixXd& pi){
+    _reverse.assign(nStates, AliasTable());
+    _reverseTargets.assign(nStates, std::vector<int>());
+    std::vector<double> weights;
+    for(int i = 0; i < nStates; i++){
+        weights.clear();
+        //P~(i,j) is proportional to pi(j) P(j,i); the alias table normalizes
+        for(int j = 0; j < nStates; j++){
+            double w = pi(0,j) * P(j,i);
+            if(w > 0){
+                weights.push_back(w);
+                _reverseTargets[i].push_back(j);
+            }
+        }
+        if(weights.empty()){
+            throw "Error: chain is not irreducible, or pi is not its stationary distribution.";
+        }
+        _reverse[i] = AliasTable(weights.data(), weights.size());
+    }
+}
+
+/**
+ * @name FillSampler::attempt
+ * @param t: horizon
+ * @param v: 2t uniforms, the first t for the reversed path and the rest for the forward uniforms
+ * @return: x_0, or -1
+ */
+int FillSampler::attempt(int t, const double* v){
+    _path.resize(t+1);
+    _path[t] = z;
+    for(int s = t; s > 0; s--){
+        int x = _path[s];
+        _path[s-1] = _reverseTargets[x][_reverse[x].sample(v[t-s])];
+    }
+    //U_s, conditioned on update(x_{s-1}, U_s) = x_s
+    const double* w = v + t;
+    _images.reset(nStates);
+    for(int s = 1; s <= t && !_images.coalesced(); s++){
+        int from = _path[s-1];
+        int to = _path[s];
+        double hi = _engine.cdf(from, to);
+        double lo = (to > 0) ? _engine.cdf(from, to-1) : 0.0;
+        //(lo, hi], so the map really sends from to to
+        double u = hi - (hi - lo) * w[s-1];
+        _images.step([this, u](int x){ return _engine.update(x, u); });
+    }
+    //the copy started at x_0 follows the path, so a single image is z
+    return _images.coalesced() ? _path[0] : -1;
+}
+
+bool is_stochastically_monotone(const Eigen::MatrixXd &mat, double tol){
+    int n = mat.cols();
+    Eigen::RowVectorXd prev = Eigen::RowVectorXd::Ones(n);
+    Eigen::RowVectorXd cur(n);
+    for(int i = 0; i < n; i++){
+        double s = 0;
+        for(int j = 0; j < n; j++){
+            s += mat(i,j);
+            cur(j) = s;
+            if(cur(j) > prev(j) + tol){
+                return false;
+            }
+        }
+        prev.swap(cur);
+    }
+    return true;
+}
+
+int monotone_CFTP(const Eigen::MatrixXd &mat, RNG& rng){
+    CFTPEngine engine(mat);
+    auto cftp = make_monotone_CFTP(0, static_cast<int>(mat.cols()) - 1, [&engine](int x, double u){
+        return engine.update(x, u);
+    });
+    auto sample = cftp.sample(rng);
+    return sample ? *sample : -1;
+}
+
+int monotone_CFTP(const Eigen::MatrixXd &mat){
+    return monotone_CFTP(mat, default_rng());
+}
 
 /**
  * @author: Zane Jakobs
@@ -234,23 +585,74 @@ int iteratedVoterCFTP(std::mt19937 &gen, std::uniform_real_distribution<> &dis,
  * @param n: how many samples
  * @return: vector where i-th entry is the number of times state i appeared
  */
-std::valarray<int> sampleVoterCFTP(const Eigen::MatrixXd &mat, int n){
+template<typename Scalar>
+std::valarray<int> sampleVoterCFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, int n){
+    return sampleVoterCFTP(mat, n, default_rng()());
+}
+
+/**
+ * @param mat: matrix to sample from
+ * @param n: how many samples
+ * @param seed: seed for the per-block streams
+ * @param numThreads: number of threads, 0 for the OpenMP default
+ * @param stats: if not null, the runs' statistics are added to it
+ * @return: vector where i-th entry is the number of times state i appeared
+ */
+template<typename Scalar>
+std::valarray<int> sampleVoterCFTP(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, int n,
+                                   uint64_t seed, int numThreads, CFTPBatchStats* stats){
     int cls = mat.cols();
-    //set random seed
-    random_device rd;
-    //init Mersenne Twistor
-    mt19937 gen(rd());
-    // unif(0,1)
-    uniform_real_distribution<> dis(0.0,1.0);
-    
+    //samples per block: large enough to amortize seeding, small enough to balance the load
+    const int block = 64;
+    int numBlocks = (n + block - 1)/block;
+    int threads = 1;
+#ifdef _OPENMP
+    threads = (numThreads > 0) ? numThreads : omp_get_max_threads();
+#endif
+    CFTPEngine prototype(mat);
+    std::vector<int> counts(cls, 0);
+    long failures = 0;
+#pragma omp parallel num_threads(threads) reduction(+:failures)
+    {
+        CFTPEngine engine(prototype);
+        std::vector<int> local(cls, 0);
+        CFTPStats run;
+        CFTPBatchStats localStats;
+        CFTPStats* runPtr = stats ? &run : nullptr;
+#pragma omp for schedule(dynamic)
+        for(int b = 0; b < numBlocks; b++){
+            RNG gen(seed, b);
+            int end = std::min(n, (b+1)*block);
+            for(int i = b*block; i < end; i++){
+                int sample = engine.sample(gen, runPtr);
+                if(sample != -1){
+                    local[sample]++;
+                } else{
+                    failures++;
+                }
+                if(stats){
+                    localStats.add(run);
+                }
+            }
+        }
+#pragma omp critical
+        {
+            for(int j = 0; j < cls; j++){
+                counts[j] += local[j];
+            }
+            if(stats){
+                stats->merge(localStats);
+            }
+        }
+    }
+    //dropping the runs that hit the horizon would bias the counts towards states reached by
+    //fast-coalescing runs, so a partial histogram is never returned
+    if(failures > 0){
+        throw "Error: voter CFTP did not coalesce within the maximum horizon for some samples.";
+    }
     valarray<int> arr(cls);
-    int sample;
-    std::deque<double> R;
-    Eigen::MatrixXd M(cls,15);
-    Eigen::MatrixXd temp;
-    for(int i = 0; i< n; i++){
-        sample = iteratedVoterCFTP( gen, dis, mat, R, M, temp, cls, false);
-        arr[sample]++;
+    for(int j = 0; j < cls; j++){
+        arr[j] = counts[j];
     }
     return arr;
 }
@@ -259,10 +661,13 @@ std::valarray<int> sampleVoterCFTP(const Eigen::MatrixXd &mat, int n){
  * @author: Zane Jakobs
  * @param mat: matrix to sample from
  * @param n: how many samples
+ * @param stats: if not null, the runs' statistics are added to it
  * @return: VectorXd where i-th entry is the density of state i
  */
-    Eigen::VectorXd voterCFTPDistribution(const Eigen::MatrixXd &mat, int n){
-    std::valarray<int> counts = sampleVoterCFTP(mat, n);
+template<typename Scalar>
+    Eigen::VectorXd voterCFTPDistribution(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat, int n,
+                                          CFTPBatchStats* stats){
+    std::valarray<int> counts = sampleVoterCFTP(mat, n, default_rng()(), 0, stats);
     Eigen::VectorXd res(mat.cols());
     double sum = double(counts.sum());
     for(int i = 0; i < mat.cols(); i++){
@@ -271,4 +676,15 @@ std::valarray<int> sampleVoterCFTP(const Eigen::MatrixXd &mat, int n){
     return res;
 }
 
+template int voter_CFTP<double>(const Eigen::MatrixXd&, RNG&);
+template int voter_CFTP<float>(const Eigen::MatrixXf&, RNG&);
+template int voter_CFTP<double>(const Eigen::MatrixXd&);
+template int voter_CFTP<float>(const Eigen::MatrixXf&);
+template std::valarray<int> sampleVoterCFTP<double>(const Eigen::MatrixXd&, int);
+template std::valarray<int> sampleVoterCFTP<float>(const Eigen::MatrixXf&, int);
+template std::valarray<int> sampleVoterCFTP<double>(const Eigen::MatrixXd&, int, uint64_t, int, CFTPBatchStats*);
+template std::valarray<int> sampleVoterCFTP<float>(const Eigen::MatrixXf&, int, uint64_t, int, CFTPBatchStats*);
+template Eigen::VectorXd voterCFTPDistribution<double>(const Eigen::MatrixXd&, int, CFTPBatchStats*);
+template Eigen::VectorXd voterCFTPDistribution<float>(const Eigen::MatrixXf&, int, CFTPBatchStats*);
+
 }
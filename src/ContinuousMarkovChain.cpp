@@ -0,0 +1,334 @@
+/**
+ * @summary : implementation of a continuous-time Markov chain.
+ * Note that any individual functions not written by the author here have source links in the comments above the declaration
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+#ifdef Success
+#undef Success
+#endif
+#include"../include/ContinuousMarkovChain.h"
+#include<vector>
+#include<Eigen/Core>
+#include<Eigen/Dense>
+#include<Eigen/Sparse>
+#include<unsupported/Eigen/MatrixFunctions>
+#include<random>
+#include<cmath>
+#include<algorithm>
+#include<mkl.h>
+#include"../include/MarkovFunctions.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    ContinuousMarkovChain::ContinuousMarkovChain(const Eigen::MatrixXd& generator, const Eigen::MatrixXd& initial){
+        setGenerator(generator);
+        _initial = initial;
+    }
+
+    ContinuousMarkovChain::ContinuousMarkovChain(const Eigen::SparseMatrix<double>& generator, const Eigen::MatrixXd& initial){
+        setGenerator(generator);
+        _initial = initial;
+    }
+
+    void ContinuousMarkovChain::setGenerator(const Eigen::MatrixXd& generator){
+        _generator = generator.sparseView();
+        numStates = generator.cols();
+        buildJumpTables();
+    }
+
+    void ContinuousMarkovChain::setGenerator(const Eigen::SparseMatrix<double>& generator){
+        _generator = generator;
+        _generator.makeCompressed();
+        numStates = generator.cols();
+        buildJumpTables();
+    }
+
+    void ContinuousMarkovChain::setInitial(const Eigen::MatrixXd& initial){
+        _initial = initial;
+    }
+
+    Eigen::MatrixXd ContinuousMarkovChain::getGenerator() const { return Eigen::MatrixXd(_generator); }
+    const Eigen::SparseMatrix<double, Eigen::RowMajor>& ContinuousMarkovChain::getSparseGenerator() const { return _generator; }
+    Eigen::MatrixXd ContinuousMarkovChain::getInit() const { return _initial; }
+    int ContinuousMarkovChain::getNumStates() const { return numStates; }
+
+    void ContinuousMarkovChain::buildJumpTables(){
+        _exitRates.assign(numStates, 0.0);
+        _jumpTables.assign(numStates, AliasTable());
+        _jumpTargets.assign(numStates, std::vector<int>());
+        std::vector<double> rates;
+        for(unsigned i = 0; i < numStates; i++){
+            rates.clear();
+            for(Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(_generator, i); it; ++it){
+                if(it.col() != i && it.value() > 0){
+                    rates.push_back(it.value());
+                    _jumpTargets[i].push_back(it.col());
+                    _exitRates[i] += it.value();
+                }
+            }
+            if(!rates.empty()){
+                _jumpTables[i] = AliasTable(rates.data(), rates.size());
+            }
+        }
+    }
+
+    /**
+     * @return: max_i |Q(i,i)|
+     */
+    double ContinuousMarkovChain::uniformizationRate() const{
+        double q = 0;
+        for(auto r : _exitRates){
+            q = std::max(q, r);
+        }
+        return q;
+    }
+
+    /**
+     * @param rate: uniformization rate
+     * @return: discrete chain with transition matrix I + Q/rate
+     */
+    MarkovChain ContinuousMarkovChain::uniformizedChain(double rate) const{
+        Eigen::MatrixXd P = Eigen::MatrixXd::Identity(numStates, numStates) + getGenerator()/rate;
+        return MarkovChain(P, _initial, numStates);
+    }
+
+    /**
+     * @return: jump chain
+     */
+    MarkovChain ContinuousMarkovChain::embeddedChain() const{
+        Eigen::MatrixXd P = Eigen::MatrixXd::Zero(numStates, numStates);
+        for(unsigned i = 0; i < numStates; i++){
+            if(_exitRates[i] == 0){
+                P(i,i) = 1.0;
+                continue;
+            }
+            for(Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(_generator, i); it; ++it){
+                if(it.col() != i){
+                    P(i, it.col()) = it.value()/_exitRates[i];
+                }
+            }
+        }
+        return MarkovChain(P, _initial, numStates);
+    }
+
+    /**
+     * @return: 1 x N stationary distribution
+     */
+    Eigen::MatrixXd ContinuousMarkovChain::stationaryDistribution() const{
+        Eigen::SparseMatrix<double> Q = _generator;
+        return stationary_from_generator(Q);
+    }
+
+    /**
+     * @param lambda: Poisson rate
+     * @param eps: bound on the neglected mass
+     * @param left: first index kept
+     * @return: normalized weights for left, left+1, ..., left + size - 1
+     * @source: Fox and Glynn, "Computing Poisson probabilities", CACM 31(4), 1988. Like their
+     * algorithm, weights are computed relative to the mode so nothing underflows; the
+     * truncation points come from geometric bounds on the tails instead of their closed forms
+     */
+    std::vector<double> poisson_weights(double lambda, double eps, int& left){
+        if(lambda <= 0){
+            left = 0;
+            return std::vector<double>(1, 1.0);
+        }
+        int mode = static_cast<int>(std::floor(lambda));
+        double W = 1.0; //w(mode) = 1
+
+        //right tail: ratios lambda/(k+1) decrease, so the tail past k is at most w_k * r/(1-r)
+        std::vector<double> up;
+        double w = 1.0;
+        for(int k = mode; ; k++){
+            w *= lambda/(k+1);
+            up.push_back(w);
+            W += w;
+            double r = lambda/(k+2);
+            if(w * r/(1.0 - r) < 0.5 * eps * W){
+                break;
+            }
+        }
+
+        //left tail: ratios k/lambda decrease going down
+        std::vector<double> down;
+        w = 1.0;
+        for(int k = mode; k > 0; k--){
+            w *= k/lambda;
+            down.push_back(w);
+            W += w;
+            double r = (k-1)/lambda;
+            if(r < 1.0 && w * r/(1.0 - r) < 0.5 * eps * W){
+                break;
+            }
+        }
+
+        left = mode - static_cast<int>(down.size());
+        std::vector<double> weights;
+        weights.reserve(down.size() + 1 + up.size());
+        weights.insert(weights.end(), down.rbegin(), down.rend());
+        weights.push_back(1.0);
+        weights.insert(weights.end(), up.begin(), up.end());
+        for(auto &x : weights){
+            x /= W;
+        }
+        return weights;
+    }
+
+    /**
+     * @name ContinuousMarkovChain::transientDistribution
+     * @param t: time
+     * @param eps: truncation error bound
+     * @return: _initial * exp(Q t) = sum_k Poisson(k; q t) * _initial * P^k, P = I + Q/q
+     */
+    Eigen::MatrixXd ContinuousMarkovChain::transientDistribution(double t, double eps) const{
+        double q = uniformizationRate();
+        if(q == 0 || t <= 0){
+            return _initial;
+        }
+        //a slightly larger rate keeps P aperiodic
+        q *= 1.02;
+        Eigen::SparseMatrix<double, Eigen::RowMajor> I(numStates, numStates);
+        I.setIdentity();
+        Eigen::SparseMatrix<double, Eigen::RowMajor> P = I + _generator/q;
+
+        int left;
+        auto weights = poisson_weights(q*t, eps, left);
+        int right = left + static_cast<int>(weights.size()) - 1;
+
+        Eigen::RowVectorXd cur = _initial.row(0);
+        Eigen::RowVectorXd next(numStates);
+        Eigen::RowVectorXd res = Eigen::RowVectorXd::Zero(numStates);
+        for(int k = 0; k <= right; k++){
+            if(k >= left){
+                res += weights[k - left] * cur;
+            }
+            if(k < right){
+                next.noalias() = cur * P;
+                cur.swap(next);
+            }
+        }
+        return res;
+    }
+
+    /**
+     * @name ContinuousMarkovChain::transientDistributionKrylov
+     * @param t: time
+     * @param m: dimension of the Krylov subspace
+     * @param tol: local error tolerance per time step
+     * @return: _initial * exp(Q t)
+     * @source: time stepping and error estimate follow Sidje, "Expokit", ACM TOMS 24(1), 1998
+     */
+    Eigen::MatrixXd ContinuousMarkovChain::transientDistributionKrylov(double t, int m, double tol) const{
+        Eigen::SparseMatrix<double> A = _generator.transpose();
+        Eigen::VectorXd v = _initial.row(0).transpose();
+        m = std::min<int>(m, numStates);
+        if(t <= 0 || m < 1){
+            return _initial;
+        }
+        const double breakdown_tol = 1.0e-12;
+        const int max_halvings = 60;
+
+        Eigen::MatrixXd V(numStates, m+1);
+        Eigen::MatrixXd H(m+1, m);
+        Eigen::VectorXd w(numStates);
+
+        double tNow = 0;
+        double tau = t;
+        while(tNow < t){
+            double beta = v.norm();
+            if(beta == 0){
+                break;
+            }
+            //Arnoldi process; the basis does not depend on the step size, so it is reused if we shrink tau
+            V.col(0) = v/beta;
+            H.setZero();
+            int mEff = m;
+            bool happy = false;
+            for(int j = 0; j < m; j++){
+                w.noalias() = A * V.col(j);
+                for(int i = 0; i <= j; i++){
+                    H(i,j) = V.col(i).dot(w);
+                    w -= H(i,j) * V.col(i);
+                }
+                double h = w.norm();
+                H(j+1,j) = h;
+                if(h < breakdown_tol){
+                    mEff = j+1;
+                    happy = true;
+                    break;
+                }
+                V.col(j+1) = w/h;
+            }
+
+            tau = std::min(tau, t - tNow);
+            Eigen::MatrixXd E;
+            for(int halvings = 0; ; halvings++){
+                E = (tau * H.topLeftCorner(mEff, mEff)).exp();
+                if(happy){
+                    break;
+                }
+                double err = beta * H(mEff, mEff-1) * std::abs(E(mEff-1, 0));
+                if(err <= tol){
+                    break;
+                }
+                if(halvings == max_halvings){
+                    throw "Error: Krylov step cannot meet the tolerance; increase m or tol.";
+                }
+                tau *= 0.5;
+            }
+            v = beta * (V.leftCols(mEff) * E.col(0));
+            tNow += tau;
+            //happy breakdown means the subspace is invariant, so any step is exact
+            tau = happy ? t - tNow : 2.0 * tau;
+        }
+        return v.transpose();
+    }
+
+    /**
+     * @name ContinuousMarkovChain::simulate
+     * @param tEnd: time horizon
+     * @param gen: random engine
+     * @return: jump times and the states entered at those times
+     */
+    template<typename Engine>
+    CTMCPath ContinuousMarkovChain::simulatePath(double tEnd, Engine& gen) const{
+        uniform_real_distribution<> dis(0.0,1.0);
+        CTMCPath path;
+        Eigen::RowVectorXd init = _initial.row(0);
+        AliasTable initTable(init.data(), numStates);
+
+        int state = initTable.sample(dis(gen));
+        double time = 0;
+        path.times.push_back(time);
+        path.states.push_back(state);
+        while(true){
+            double rate = _exitRates[state];
+            if(rate == 0){
+                break; //absorbing
+            }
+            time += -std::log(1.0 - dis(gen))/rate;
+            if(time > tEnd){
+                break;
+            }
+            state = _jumpTargets[state][_jumpTables[state].sample(dis(gen))];
+            path.times.push_back(time);
+            path.states.push_back(state);
+        }
+        return path;
+    }
+
+    CTMCPath ContinuousMarkovChain::simulate(double tEnd, std::mt19937& gen) const{
+        return simulatePath(tEnd, gen);
+    }
+
+    CTMCPath ContinuousMarkovChain::simulate(double tEnd, RNG& gen) const{
+        return simulatePath(tEnd, gen);
+    }
+
+    CTMCPath ContinuousMarkovChain::simulate(double tEnd) const{
+        return simulatePath(tEnd, default_rng());
+    }
+}
@@ -2,6 +2,8 @@
 #define _USE_MATH_DEFINES
 #endif
 #include <cstdlib>
+#include <cmath>
+#include <limits>
 #include "../include/Distributions.h"  
 using namespace std;
 //using namespace Markov;
@@ -13,8 +15,12 @@ namespace Markov {
      */
     pair<default_random_engine, uniform_real_distribution<double> > std_sampler_pair() noexcept
     {
-        random_device rd;
-        default_random_engine gen(rd());
+        return std_sampler_pair(default_rng());
+    }
+    
+    pair<default_random_engine, uniform_real_distribution<double> > std_sampler_pair(RNG& rng) noexcept
+    {
+        default_random_engine gen(static_cast<default_random_engine::result_type>(rng()));
         uniform_real_distribution<double> dis(0,1);
         return std::make_pair(gen, dis);
     }
@@ -42,9 +48,10 @@ namespace Markov {
     
     vector<double> update_uniform_sample_vector(vector<double>& sample_seq, pair<default_random_engine, uniform_real_distribution<double> >& spar, unsigned additions) noexcept
     {
-        for(unsigned i = 0; i < additions; i++){
-            auto it = sample_seq.begin();
-            sample_seq.insert(it, spar.second(spar.first));
+        //one insert shifts the old samples once, instead of once per new sample
+        sample_seq.insert(sample_seq.begin(), additions, 0.0);
+        for(unsigned i = additions; i > 0; i--){
+            sample_seq[i-1] = spar.second(spar.first);
         }
         return sample_seq;
     }
@@ -68,6 +75,12 @@ namespace Markov {
        // double p = pow(M_E, -lambda)*pow(lambda,double(x))/TMP_factorial<x>;
         return static_cast<double>(-1);//p;
     }
+    double Poisson::logpdf(const int& x) const noexcept{
+        if(x < 0){
+            return -numeric_limits<double>::infinity();
+        }
+        return x*log(lambda) - lambda - lgamma(x + 1.0);
+    }
     //returns P( X <= x)
     constexpr double Poisson::cdf(const int& x) noexcept{
         double sum = 0;
@@ -78,11 +91,7 @@ namespace Markov {
     }
     //generates a sample
     int Poisson::sample() noexcept{
-        random_device rd;
-        std::default_random_engine gen(rd());
-        std::poisson_distribution<int> dis(lambda);
-        
-        return dis(gen);
+        return sample(default_rng());
     }
    
     
@@ -90,9 +99,19 @@ namespace Markov {
         lambda = _lambda;
     }
     double Exponential::pdf(double x) noexcept{
+        if(x < 0){
+            return 0.0;
+        }
         return (lambda*pow(M_E, -lambda*x));
     }
         
+    double Exponential::logpdf(double x) const noexcept{
+        if(x < 0){
+            return -numeric_limits<double>::infinity();
+        }
+        return log(lambda) - lambda*x;
+    }
+        
      double Exponential::cdf(double x) noexcept{
         return (1-pow(M_E,-lambda*x));
     }
@@ -106,10 +125,7 @@ namespace Markov {
     }
         
     double Exponential::sample() noexcept {
-        random_device rd;
-        default_random_engine gen(rd());
-        exponential_distribution<double> dis(lambda);
-        return dis(gen);
+        return sample(default_rng());
     }
     
     constexpr void Normal::setMu(double _mu) noexcept{
@@ -123,6 +139,10 @@ namespace Markov {
     double Normal::pdf(double x) const noexcept{
         return pow(M_E, -((x-mu)*(x-mu))/(2*sigma*sigma))/(sroot2pi*sigma);
     }
+    double Normal::logpdf(double x) const noexcept{
+        double z = (x-mu)/sigma;
+        return -0.5*z*z - log(sroot2pi*sigma);
+    }
     constexpr double Normal::mean() const noexcept{
         return mu;
     }
@@ -131,10 +151,7 @@ namespace Markov {
     }
         
     double Normal::sample() const noexcept{
-        random_device rd;
-        default_random_engine gen(rd());
-        normal_distribution<double> dis(mu,sigma);
-        return dis(gen);
+        return sample(default_rng());
     }
     
     /**
@@ -142,14 +159,7 @@ namespace Markov {
      *@return: vector of samples from a normal distribution
      */
     vector<double> Normal::create_sample_vector(unsigned length) const noexcept{
-        random_device rd;
-        default_random_engine gen(rd());
-        normal_distribution<double> dis(mu,sigma);
-        vector<double> vec(length);
-        for(auto &i : vec){
-            i = dis(gen);
-        }
-        return vec;
+        return create_sample_vector(length, default_rng());
     }
     
     /**
@@ -158,13 +168,7 @@ namespace Markov {
      *@brief: vector with additions many new samples from a Normal(mu,sigma) distribution.
      */
     void Normal::update_sample_vector(vector<double>& sample_seq, unsigned additions) const noexcept{
-        random_device rd;
-        default_random_engine gen(rd());
-        normal_distribution<double> dis(mu,sigma);
-        
-        for(unsigned i = 0; i < additions; i++){
-            sample_seq.push_back(dis(gen));
-        }
+        update_sample_vector(sample_seq, additions, default_rng());
     }
     
     
@@ -185,8 +189,21 @@ namespace Markov {
     }
     
     const double Gamma::pdf(double x) const noexcept{
+        if(x < 0){
+            return 0.0;
+        }
         return (pow(x,alpha - 1)*pow(M_E, -x/beta)/(tgamma(alpha)*pow(beta,alpha)));
     }
+    double Gamma::logpdf(double x) const noexcept{
+        if(x < 0){
+            return -numeric_limits<double>::infinity();
+        }
+        //at 0 the density is 1/beta for alpha == 1, where (alpha - 1)*log(x) would be nan
+        if(x == 0 && alpha == 1){
+            return -log(beta);
+        }
+        return (alpha - 1)*log(x) - x/beta - lgamma(alpha) - alpha*log(beta);
+    }
     constexpr double Gamma::mean() noexcept{
         return alpha*beta;
     }
@@ -194,10 +211,7 @@ namespace Markov {
         return (alpha*beta*beta);
     }
     double Gamma::sample() noexcept{
-        random_device rd;
-        default_random_engine gen(rd());
-        gamma_distribution<double> dis(alpha,beta);
-        return dis(gen);
+        return sample(default_rng());
     }
     
     constexpr void AsymmetricStudentT::setLocation(double _loc) noexcept{
@@ -291,6 +305,23 @@ namespace Markov {
         auto stdX = static_cast<double>((x-location)/scale);
         return (fast_std_pdf(stdX));
     }
+    //log(1 + z^2), without overflowing z^2 far out in the tails
+    static double log1p_square(double z) noexcept{
+        z = abs(z);
+        return z > 1.0e150 ? 2.0*log(z) : log1p(z*z);
+    }
+    
+    double AsymmetricStudentT::logpdf(double x) const noexcept{
+        auto stdX = static_cast<double>((x-location)/scale);
+        auto astar = skew*K(ltail)/ ( skew*K(ltail) + (1-skew) * K(rtail));
+        auto log_normalize_left = log(astar*(1-skew)/( skew* (1-astar)));
+        if( stdX <= 0){
+            return log_normalize_left - 0.5*(1+ltail)*log1p_square(stdX/(2*astar*sqrt(ltail)));
+        }
+        else{
+            return log_normalize_left - 0.5*(1+rtail)*log1p_square(stdX/(2*(1.0-astar)*sqrt(rtail)));
+        }
+    }
     double AsymmetricStudentT::cdf(double x) const noexcept{
         if(x == 0){
             return skew;
@@ -339,11 +370,91 @@ namespace Markov {
    //     return 1.0/(M_PI*sigma* (1+adjX*adjX));
    // }
     
+    /**
+     *@return: lower Cholesky factor of Sigma, throwing if Sigma is not positive definite
+     */
+    static Eigen::MatrixXd cholesky_factor(const Eigen::MatrixXd& Sigma){
+        Eigen::LLT<Eigen::MatrixXd> llt(Sigma);
+        if(llt.info() != Eigen::Success){
+            throw "Error: covariance matrix is not positive definite.";
+        }
+        return llt.matrixL();
+    }
+    
+    MultivariateNormal::MultivariateNormal(const Eigen::VectorXd& m, const Eigen::MatrixXd& Sigma) : mu(m){
+        if(Sigma.rows() != m.size() || Sigma.cols() != m.size()){
+            throw "Error: covariance matrix does not match the dimension of the mean.";
+        }
+        L = cholesky_factor(Sigma);
+        log_norm = -0.5*m.size()*log(2*M_PI) - L.diagonal().array().log().sum();
+    }
+    
+    double MultivariateNormal::logpdf(const Eigen::Ref<const Eigen::VectorXd>& x) const noexcept{
+        Eigen::VectorXd z = L.triangularView<Eigen::Lower>().solve(x - mu);
+        return log_norm - 0.5*z.squaredNorm();
+    }
+    
+    /**
+     *@return: the first X.rows() rows of work, holding row i = (L^{-1}(x_i - mu))^T. work
+     * grows by doubling and is never shrunk
+     */
+    static Eigen::Block<Eigen::MatrixXd> whiten_rows(const Eigen::Ref<const Eigen::MatrixXd>& X, const Eigen::VectorXd& mu,
+                                                     const Eigen::MatrixXd& L, Eigen::MatrixXd& work){
+        if(work.cols() != X.cols()){
+            work.resize(X.rows(), X.cols());
+        } else if(work.rows() < X.rows()){
+            work.resize(std::max(X.rows(), 2*work.rows()), X.cols());
+        }
+        auto Z = work.topRows(X.rows());
+        Z = X.rowwise() - mu.transpose();
+        //Z L^T = X - mu^T, a triangular solve from the right, in place
+        L.transpose().triangularView<Eigen::Upper>().solveInPlace<Eigen::OnTheRight>(Z);
+        return Z;
+    }
+    
+    void MultivariateNormal::logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out) const{
+        Eigen::MatrixXd work;
+        logpdf_block(X, out, work);
+    }
+    
+    void MultivariateNormal::logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, Eigen::MatrixXd& work) const{
+        auto Z = whiten_rows(X, mu, L, work);
+        for(int i = 0; i < Z.rows(); i++){
+            out[i] = log_norm - 0.5*Z.row(i).squaredNorm();
+        }
+    }
+    
+    MultivariateStudentT::MultivariateStudentT(const Eigen::VectorXd& m, const Eigen::MatrixXd& Sigma, double _nu) : mu(m), nu(_nu){
+        if(Sigma.rows() != m.size() || Sigma.cols() != m.size()){
+            throw "Error: scale matrix does not match the dimension of the location.";
+        }
+        if(!(nu > 0)){
+            throw "Error: degrees of freedom must be positive.";
+        }
+        L = cholesky_factor(Sigma);
+        double d = m.size();
+        log_norm = lgamma(0.5*(nu + d)) - lgamma(0.5*nu) - 0.5*d*log(nu*M_PI) - L.diagonal().array().log().sum();
+    }
+    
+    double MultivariateStudentT::logpdf(const Eigen::Ref<const Eigen::VectorXd>& x) const noexcept{
+        Eigen::VectorXd z = L.triangularView<Eigen::Lower>().solve(x - mu);
+        return log_norm - 0.5*(nu + mu.size())*log1p(z.squaredNorm()/nu);
+    }
+    
+    void MultivariateStudentT::logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out) const{
+        Eigen::MatrixXd work;
+        logpdf_block(X, out, work);
+    }
+    
+    void MultivariateStudentT::logpdf_block(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out, Eigen::MatrixXd& work) const{
+        auto Z = whiten_rows(X, mu, L, work);
+        for(int i = 0; i < Z.rows(); i++){
+            out[i] = log_norm - 0.5*(nu + mu.size())*log1p(Z.row(i).squaredNorm()/nu);
+        }
+    }
+    
     double Cauchy::sample() const noexcept{
-        random_device rd;
-        default_random_engine gen(rd());
-        cauchy_distribution<double> dis(mu,sigma);
-        return abv ? abs(dis(gen)) : dis(gen);
+        return sample(default_rng());
     }
     
     /**
@@ -352,14 +463,7 @@ namespace Markov {
      * TODO: TEMPLATIZE SAMPLE VECTOR CREATION
      */
     vector<double> Cauchy::create_sample_vector(unsigned length) const noexcept{
-        random_device rd;
-        default_random_engine gen(rd());
-        cauchy_distribution<double> dis(mu,sigma);
-        vector<double> vec(length);
-        for(auto &i : vec){
-            i = abv ? abs(dis(gen)) : dis(gen);
-        }
-        return vec;
+        return create_sample_vector(length, default_rng());
     }
     
     /**
@@ -368,14 +472,7 @@ namespace Markov {
      *@brief: vector with additions many new samples from a Normal(mu,sigma) distribution.
      */
     void Cauchy::update_sample_vector(vector<double>& sample_seq, unsigned additions) const noexcept{
-        random_device rd;
-        default_random_engine gen(rd());
-        cauchy_distribution<double> dis(mu,sigma);
-        
-        for(unsigned i = 0; i < additions; i++){
-            auto spl = abv ? abs(dis(gen)) : dis(gen);
-            sample_seq.push_back(spl);
-        }
+        update_sample_vector(sample_seq, additions, default_rng());
     }
     
 }
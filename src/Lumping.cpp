@@ -0,0 +1,278 @@
+/**
+ * @summary : exact lumping of Markov chains by partition refinement.
+ * Note that any individual functions not written by the author here have source links in the comments above the declaration
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+#ifdef Success
+#undef Success
+#endif
+#include"../include/Lumping.h"
+#include<vector>
+#include<deque>
+#include<map>
+#include<algorithm>
+#include<utility>
+#include<Eigen/Core>
+#include<Eigen/Sparse>
+#include<mkl.h>
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    /**
+     * @param P: N x N transition matrix
+     * @param initialPartition: label of each state, or empty
+     * @param tol: weights closer than tol are treated as equal
+     * @return: block index of each state
+     * @source: Derisavi, Hermanns and Sanders, "Optimal state-space lumping in Markov chains",
+     * Information Processing Letters 87(6), 2003
+     */
+    std::vector<int> coarsest_lumpable_partition(const Eigen::SparseMatrix<double>& P, const std::vector<int>& initialPartition, double tol){
+        int n = P.cols();
+        std::vector<int> blockOf(n, 0);
+        std::vector<std::vector<int> > blocks;
+        std::vector<int> posInBlock(n, 0);
+
+        //initial blocks from the labels
+        if(initialPartition.empty()){
+            blocks.emplace_back(n);
+            for(int s = 0; s < n; s++){
+                blocks[0][s] = s;
+            }
+        }
+        else{
+            std::map<int,int> labelToBlock;
+            for(int s = 0; s < n; s++){
+                auto it = labelToBlock.find(initialPartition[s]);
+                if(it == labelToBlock.end()){
+                    it = labelToBlock.emplace(initialPartition[s], blocks.size()).first;
+                    blocks.emplace_back();
+                }
+                blocks[it->second].push_back(s);
+            }
+        }
+        for(std::size_t b = 0; b < blocks.size(); b++){
+            for(std::size_t i = 0; i < blocks[b].size(); i++){
+                blockOf[blocks[b][i]] = b;
+                posInBlock[blocks[b][i]] = i;
+            }
+        }
+
+        std::deque<int> splitters;
+        std::vector<char> queued(blocks.size(), 1);
+        for(std::size_t b = 0; b < blocks.size(); b++){
+            splitters.push_back(b);
+        }
+
+        //scratch space, reused across splitters
+        std::vector<double> weight(n, 0.0);
+        std::vector<char> touched(n, 0);
+        std::vector<int> touchedStates;
+        std::vector<int> touchedBlocks;
+        std::vector<std::vector<std::pair<double,int> > > byBlock;
+        std::vector<int> splitter;
+
+        while(!splitters.empty()){
+            int C = splitters.front();
+            splitters.pop_front();
+            queued[C] = 0;
+            //snapshot, since splitting below may change block C itself
+            splitter = blocks[C];
+
+            //w(s) = P(s, C) for every predecessor s of C
+            touchedStates.clear();
+            for(auto t : splitter){
+                for(Eigen::SparseMatrix<double>::InnerIterator it(P, t); it; ++it){
+                    int s = it.row();
+                    if(!touched[s]){
+                        touched[s] = 1;
+                        weight[s] = 0.0;
+                        touchedStates.push_back(s);
+                    }
+                    weight[s] += it.value();
+                }
+            }
+
+            //group touched states by block
+            touchedBlocks.clear();
+            for(auto s : touchedStates){
+                int b = blockOf[s];
+                if(b >= static_cast<int>(byBlock.size())){
+                    byBlock.resize(blocks.size());
+                }
+                if(byBlock[b].empty()){
+                    touchedBlocks.push_back(b);
+                }
+                byBlock[b].emplace_back(weight[s], s);
+            }
+
+            for(auto B : touchedBlocks){
+                auto& members = byBlock[B];
+                std::sort(members.begin(), members.end());
+                const int numMembers = members.size();
+                int untouched = blocks[B].size() - numMembers;
+
+                //split sorted weights into runs of (nearly) equal values; states not touched have weight 0
+                std::vector<std::pair<int,int> > groups; //[begin, end) into members
+                int begin = 0;
+                if(untouched > 0){
+                    while(begin < numMembers && members[begin].first <= tol){
+                        begin++;
+                    }
+                    untouched += begin; //these stay with the weight-0 states
+                }
+                for(int i = begin; i < numMembers; i++){
+                    if(i + 1 == numMembers || members[i+1].first - members[i].first > tol){
+                        groups.emplace_back(begin, i+1);
+                        begin = i+1;
+                    }
+                }
+                const int numGroups = groups.size();
+                int numParts = numGroups + (untouched > 0 ? 1 : 0);
+                if(numParts <= 1){
+                    members.clear();
+                    continue;
+                }
+
+                /*
+                 the weight-0 states are not enumerated, so they keep block B. If there are none,
+                 the largest group keeps B, so that the fewest states move
+                 */
+                int keep = -1;
+                int largestSize = untouched;
+                int largestBlock = B;
+                if(untouched == 0){
+                    keep = 0;
+                    for(int g = 1; g < numGroups; g++){
+                        if(groups[g].second - groups[g].first > groups[keep].second - groups[keep].first){
+                            keep = g;
+                        }
+                    }
+                    largestSize = groups[keep].second - groups[keep].first;
+                }
+                bool wasQueued = queued[B];
+                std::vector<int> newBlocks;
+                for(int g = 0; g < numGroups; g++){
+                    if(g == keep){
+                        continue;
+                    }
+                    int nb = blocks.size();
+                    blocks.emplace_back();
+                    queued.push_back(0);
+                    for(int i = groups[g].first; i < groups[g].second; i++){
+                        int s = members[i].second;
+                        //swap-remove s from B
+                        auto& old = blocks[B];
+                        int p = posInBlock[s];
+                        old[p] = old.back();
+                        posInBlock[old[p]] = p;
+                        old.pop_back();
+                        posInBlock[s] = blocks[nb].size();
+                        blocks[nb].push_back(s);
+                        blockOf[s] = nb;
+                    }
+                    int sz = groups[g].second - groups[g].first;
+                    if(sz > largestSize){
+                        largestSize = sz;
+                        largestBlock = nb;
+                    }
+                    newBlocks.push_back(nb);
+                }
+                //re-queue everything if B was pending, otherwise all but the largest piece
+                if(!wasQueued && largestBlock != B){
+                    queued[B] = 1;
+                    splitters.push_back(B);
+                }
+                for(auto nb : newBlocks){
+                    if(wasQueued || nb != largestBlock){
+                        queued[nb] = 1;
+                        splitters.push_back(nb);
+                    }
+                }
+                members.clear();
+            }
+
+            for(auto s : touchedStates){
+                touched[s] = 0;
+            }
+        }
+        return blockOf;
+    }
+
+    /**
+     * @param mc: chain to lump
+     * @param initialPartition: label of each state, or empty
+     * @param tol: weights closer than tol are treated as equal
+     * @return: quotient chain and maps
+     */
+    LumpedChain lump(const MarkovChain& mc, const std::vector<int>& initialPartition, double tol){
+        Eigen::MatrixXd trans = mc.getTransition();
+        Eigen::SparseMatrix<double> P = trans.sparseView();
+        int n = P.cols();
+
+        LumpedChain lc;
+        auto rawBlocks = coarsest_lumpable_partition(P, initialPartition, tol);
+        //renumber blocks by smallest member, so the numbering is stable
+        std::vector<int> relabel(n, -1);
+        int numBlocks = 0;
+        lc.blockOf.resize(n);
+        for(int s = 0; s < n; s++){
+            if(relabel[rawBlocks[s]] == -1){
+                relabel[rawBlocks[s]] = numBlocks++;
+                lc.blocks.emplace_back();
+            }
+            lc.blockOf[s] = relabel[rawBlocks[s]];
+            lc.blocks[lc.blockOf[s]].push_back(s);
+        }
+
+        //any representative gives the same row of the quotient
+        Eigen::MatrixXd Q = Eigen::MatrixXd::Zero(numBlocks, numBlocks);
+        for(int b = 0; b < numBlocks; b++){
+            int s = lc.blocks[b][0];
+            for(int t = 0; t < n; t++){
+                Q(b, lc.blockOf[t]) += trans(s,t);
+            }
+        }
+        Eigen::MatrixXd init = mc.getInit();
+        Eigen::MatrixXd qinit;
+        if(init.cols() == n){
+            qinit = lump_distribution(lc, init);
+        }
+        lc.quotient.setModel(Q, qinit, numBlocks);
+        return lc;
+    }
+
+    Eigen::MatrixXd lump_distribution(const LumpedChain& lc, const Eigen::MatrixXd& dist){
+        Eigen::MatrixXd res = Eigen::MatrixXd::Zero(1, lc.blocks.size());
+        for(std::size_t s = 0; s < lc.blockOf.size(); s++){
+            res(0, lc.blockOf[s]) += dist(0,s);
+        }
+        return res;
+    }
+
+    Eigen::MatrixXd lift_distribution(const LumpedChain& lc, const Eigen::MatrixXd& blockDist, const Eigen::MatrixXd& weights){
+        int n = lc.blockOf.size();
+        Eigen::MatrixXd res(1, n);
+        for(std::size_t b = 0; b < lc.blocks.size(); b++){
+            double total = 0;
+            for(auto s : lc.blocks[b]){
+                total += weights.size() ? weights(0,s) : 1.0;
+            }
+            for(auto s : lc.blocks[b]){
+                double w = weights.size() ? weights(0,s) : 1.0;
+                res(0,s) = (total > 0) ? blockDist(0,b) * w/total : 0.0;
+            }
+        }
+        return res;
+    }
+
+    Eigen::VectorXd lift_values(const LumpedChain& lc, const Eigen::VectorXd& blockValues){
+        Eigen::VectorXd res(lc.blockOf.size());
+        for(std::size_t s = 0; s < lc.blockOf.size(); s++){
+            res(s) = blockValues(lc.blockOf[s]);
+        }
+        return res;
+    }
+}
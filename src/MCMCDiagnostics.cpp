@@ -0,0 +1,259 @@
+/**
+ * @summary : implementation of the streaming MCMC diagnostics.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+#ifdef Success
+#undef Success
+#endif
+#include"../include/MCMCDiagnostics.h"
+#include<vector>
+#include<cmath>
+#include<limits>
+#include<algorithm>
+#include<Eigen/Core>
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    void RunningMoments::merge(const RunningMoments& other) noexcept{
+        if(other.n == 0){
+            return;
+        }
+        if(n == 0){
+            *this = other;
+            return;
+        }
+        long m = n + other.n;
+        double delta = other.mean - mean;
+        mean += delta*other.n/m;
+        M2 += other.M2 + delta*delta*(static_cast<double>(n)*other.n/m);
+        n = m;
+    }
+
+    BatchMeans::BatchMeans(int maxBatches) : maxBatches(std::max(4, maxBatches + (maxBatches & 1))){
+        batches.reserve(this->maxBatches);
+    }
+
+    void BatchMeans::collapse() noexcept{
+        int half = batches.size()/2;
+        for(int i = 0; i < half; i++){
+            RunningMoments merged = batches[2*i];
+            merged.merge(batches[2*i + 1]);
+            batches[i] = merged;
+        }
+        batches.resize(half);
+        batchSize *= 2;
+    }
+
+    double BatchMeans::asymptoticVariance() const noexcept{
+        int k = batches.size();
+        if(k < 2){
+            return 0.0;
+        }
+        RunningMoments means;
+        for(const auto& b : batches){
+            means.add(b.mean);
+        }
+        return batchSize*means.variance();
+    }
+
+    double BatchMeans::ess() const noexcept{
+        double sigma2 = asymptoticVariance();
+        double n = total.n;
+        if(!(sigma2 > 0)){
+            return n;
+        }
+        return std::min(n, n*total.variance()/sigma2);
+    }
+
+    std::pair<RunningMoments, RunningMoments> BatchMeans::halves() const noexcept{
+        int k = batches.size();
+        int half = k/2;
+        std::pair<RunningMoments, RunningMoments> h;
+        for(int i = 0; i < half; i++){
+            h.first.merge(batches[i]);
+            h.second.merge(batches[k - half + i]);
+        }
+        return h;
+    }
+
+    OnlineAutocorrelation::OnlineAutocorrelation(int maxLag) : maxLag(std::max(0, maxLag)),
+    ring(std::max(1, maxLag), 0.0), lagSums(std::max(0, maxLag) + 1, 0.0), headSums(std::max(0, maxLag) + 1, 0.0) {}
+
+    void OnlineAutocorrelation::add(double x) noexcept{
+        if(n == 0){
+            shift = x;
+        }
+        double y = x - shift;
+        lagSums[0] += y*y;
+        long lags = std::min<long>(n, maxLag);
+        for(int k = 1; k <= lags; k++){
+            int i = pos - k;
+            if(i < 0){
+                i += maxLag;
+            }
+            lagSums[k] += y*ring[i];
+        }
+        sum += y;
+        n++;
+        if(n <= maxLag){
+            headSums[n] = sum;
+        }
+        if(maxLag > 0){
+            ring[pos] = y;
+            pos = (pos + 1 == maxLag) ? 0 : pos + 1;
+        }
+    }
+
+    double OnlineAutocorrelation::autocovariance(int k) const noexcept{
+        if(k > maxLag || n <= k){
+            return 0.0;
+        }
+        //sum over t >= k of (y_t - m)(y_{t-k} - m), using the exact sums of both ranges
+        double m = sum/n;
+        double tailSum = 0.0; //sum of the last k values
+        for(int i = 1; i <= k; i++){
+            int idx = pos - i;
+            if(idx < 0){
+                idx += maxLag;
+            }
+            tailSum += ring[idx];
+        }
+        double lead = sum - headSums[k]; //y_k .. y_{n-1}
+        double lag = sum - tailSum; //y_0 .. y_{n-1-k}
+        double c = lagSums[k] - m*(lead + lag) + (n - k)*m*m;
+        return c/n;
+    }
+
+    double OnlineAutocorrelation::autocorrelation(int k) const noexcept{
+        double c0 = autocovariance(0);
+        return c0 > 0 ? autocovariance(k)/c0 : 0.0;
+    }
+
+    double OnlineAutocorrelation::integratedTime() const noexcept{
+        double c0 = autocovariance(0);
+        if(!(c0 > 0)){
+            return 1.0;
+        }
+        double tau = -1.0;
+        for(int m = 0; 2*m + 1 <= maxLag; m++){
+            double pair = (autocovariance(2*m) + autocovariance(2*m + 1))/c0;
+            if(pair <= 0){
+                break;
+            }
+            tau += 2.0*pair;
+        }
+        return std::max(tau, 1.0/n);
+    }
+
+    ChainMonitor::ChainMonitor(int dim, int maxLag, int maxBatches) : coords(dim, BatchMeans(maxBatches)){
+        if(maxLag > 0){
+            acf.assign(dim, OnlineAutocorrelation(maxLag));
+        }
+    }
+
+    void ChainMonitor::setTargetESS(double ess, long checkEvery) noexcept{
+        targetESS = ess;
+        checkInterval = (checkEvery > 0) ? checkEvery : 1;
+        reached = false;
+    }
+
+    bool ChainMonitor::check() noexcept{
+        if(!reached && count() % checkInterval == 0){
+            reached = minESS() >= targetESS;
+        }
+        return !reached;
+    }
+
+    bool ChainMonitor::add(double x){
+        if(dim() != 1){
+            throw "Error: a scalar sample needs a monitor of dimension 1.";
+        }
+        coords[0].add(x);
+        if(!acf.empty()){
+            acf[0].add(x);
+        }
+        return check();
+    }
+
+    bool ChainMonitor::add(const Eigen::Ref<const Eigen::VectorXd>& x){
+        if(x.size() != dim()){
+            throw "Error: sample size does not match the monitor's dimension.";
+        }
+        for(int j = 0; j < x.size(); j++){
+            coords[j].add(x(j));
+        }
+        if(!acf.empty()){
+            for(int j = 0; j < x.size(); j++){
+                acf[j].add(x(j));
+            }
+        }
+        return check();
+    }
+
+    double ChainMonitor::minESS() const noexcept{
+        double m = std::numeric_limits<double>::infinity();
+        for(const auto& c : coords){
+            m = std::min(m, c.ess());
+        }
+        return m;
+    }
+
+    const OnlineAutocorrelation& ChainMonitor::autocorrelation(int j) const{
+        if(acf.empty()){
+            throw "Error: this monitor does not track autocorrelations; construct it with maxLag > 0.";
+        }
+        return acf[j];
+    }
+
+    double split_rhat(const std::vector<ChainMonitor>& chains, int j) noexcept{
+        //each half is one sequence of length about n
+        RunningMoments halfMeans;
+        double W = 0.0;
+        double n = std::numeric_limits<double>::infinity();
+        int sequences = 0;
+        for(const auto& chain : chains){
+            auto h = chain.coordinate(j).halves();
+            for(const auto* s : {&h.first, &h.second}){
+                if(s->n < 2){
+                    return std::numeric_limits<double>::infinity();
+                }
+                halfMeans.add(s->mean);
+                W += s->variance();
+                n = std::min(n, static_cast<double>(s->n));
+                sequences++;
+            }
+        }
+        if(sequences < 2){
+            return std::numeric_limits<double>::infinity();
+        }
+        W /= sequences;
+        double B = n*halfMeans.variance();
+        if(!(W > 0)){
+            return (B > 0) ? std::numeric_limits<double>::infinity() : 1.0;
+        }
+        double varPlus = (n - 1)/n*W + B/n;
+        return std::sqrt(varPlus/W);
+    }
+
+    double max_split_rhat(const std::vector<ChainMonitor>& chains) noexcept{
+        double r = 0.0;
+        if(chains.empty()){
+            return std::numeric_limits<double>::infinity();
+        }
+        for(int j = 0; j < chains[0].dim(); j++){
+            r = std::max(r, split_rhat(chains, j));
+        }
+        return r;
+    }
+
+    double multi_chain_ess(const std::vector<ChainMonitor>& chains, int j) noexcept{
+        double total = 0.0;
+        for(const auto& chain : chains){
+            total += chain.ess(j);
+        }
+        return total;
+    }
+}
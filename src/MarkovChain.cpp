@@ -38,27 +38,42 @@ namespace Markov
          * @source: https://www.codeproject.com/Articles/808292/Markov-chain-implementation-in-Cplusplus-using-Eig
          */
         
-    void MarkovChain::setModel( const Eigen::MatrixXd& transition, const Eigen::MatrixXd& initial, int _numStates){
+    template<typename Scalar>
+        
+    void BasicMarkovChain<Scalar>::setModel( const MatrixType& transition, const MatrixType& initial, int _numStates){
             _transition = transition;
             _initial = initial;
             numStates = _numStates;
         }
         
-        void MarkovChain::setTransition(const Eigen::MatrixXd& transition){
+        template<typename Scalar>
+        
+        void BasicMarkovChain<Scalar>::setTransition(const MatrixType& transition){
             _transition = transition;
             numStates = transition.cols();
         }
         
-        void MarkovChain::setInitial(const Eigen::MatrixXd& initial){
+        template<typename Scalar>
+        
+        void BasicMarkovChain<Scalar>::setInitial(const MatrixType& initial){
             _initial = initial;
         }
-        void MarkovChain::setNumStates(int _num){
+        template<typename Scalar>
+        void BasicMarkovChain<Scalar>::setNumStates(int _num){
             numStates = _num;
         }
+        template<typename Scalar>
+        void BasicMarkovChain<Scalar>::setMixedPrecision(bool on){
+            mixedPrecision = on;
+        }
         
-        Eigen::MatrixXd MarkovChain::getTransition(void) const { return _transition; }
-        Eigen::MatrixXd MarkovChain::getInit() const { return _initial; }
-        int MarkovChain::getNumStates(void) const {return numStates;}
+        template<typename Scalar>
+        
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::getTransition(void) const { return _transition; }
+        template<typename Scalar>
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::getInit() const { return _initial; }
+        template<typename Scalar>
+        int BasicMarkovChain<Scalar>::getNumStates(void) const {return numStates;}
     
 
     
@@ -70,8 +85,9 @@ namespace Markov
          * @param oversize: upper bound on the number of states in the chain
          * @return: maximum likelihood estimator of _transition
          */
-    Eigen::MatrixXd MarkovChain::MLE(const vector<Sequence>& df, int oversize){
-            Eigen::MatrixXd mat = Eigen::MatrixXd::Zero(oversize,oversize);
+    template<typename Scalar>
+    typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::MLE(const vector<Sequence>& df, int oversize){
+            MatrixType mat = MatrixType::Zero(oversize,oversize);
             
             //loop through data, entering values
             int largest = 0; //number of unique states
@@ -102,7 +118,8 @@ namespace Markov
          * @param n: length of sequence
          * @return: vector of ints representing the sequence
          */
-        vector<int> MarkovChain::generateSequence(int n) const noexcept{
+        template<typename Scalar>
+        vector<int> BasicMarkovChain<Scalar>::generateSequence(int n) const noexcept{
             return generate_mc_sequence(n, _transition, _initial);
         }
         
@@ -112,11 +129,12 @@ namespace Markov
          * Markov Chain.
          * @return: vector of doubles corresponding to the last stationary distribution (by order of the eigenvalues)
          */
-        Eigen::MatrixXcd MarkovChain::stationaryDistributions() const{
+        template<typename Scalar>
+        Eigen::MatrixXcd BasicMarkovChain<Scalar>::stationaryDistributions() const{
             //instantiate eigensolver
             Eigen::EigenSolver<Eigen::MatrixXd> es;
             //transpose transition matrix to find left eigenvectors
-            auto pt = _transition.transpose();
+            Eigen::MatrixXd pt = _transition.template cast<double>().transpose();
             //compute evecs, evals
             es.compute( pt, true);
             //store evals
@@ -139,14 +157,25 @@ namespace Markov
             return ((evecs.col(index).transpose())/(evecs.col(index).sum()));
         }
         
+        /**
+         * @name MarkovChain::stationaryDistribution
+         * @return: 1 x N stationary distribution
+         */
+        template<typename Scalar>
+        Eigen::MatrixXd BasicMarkovChain<Scalar>::stationaryDistribution() const{
+            Eigen::MatrixXd Q = _transition.template cast<double>() - Eigen::MatrixXd::Identity(numStates, numStates);
+            return stationary_from_generator(Q, mixedPrecision);
+        }
+        
         /**
          * @name MarkovChain::limitingDistribution
          * @summary: limitingDistribution computes the limiting distribution of the Markov chain
          * @param expon: computes 10^expon powers of _transition
          * @return limmat.row(0): limiting distribution
          */
-        Eigen::MatrixXd MarkovChain::limitingDistribution(int expon) const{
-            Eigen::MatrixXd limmat;
+        template<typename Scalar>
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::limitingDistribution(int expon) const{
+            MatrixType limmat;
             limmat = matrix_power(_transition, expon);
             return limmat.row(0);
         }
@@ -157,17 +186,90 @@ namespace Markov
          * @param expon: computes 10^expon powers of _transition
          * @return limmat: limiting distribution matrix
          */
-        Eigen::MatrixXd MarkovChain::limitingMat(int expon) const{
-            Eigen::MatrixXd limmat;
+        template<typename Scalar>
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::limitingMat(int expon) const{
+            MatrixType limmat;
             limmat = matrix_power(_transition, expon);
             return limmat;
         }
-        
+
+        //fraction of nonzero entries below which we propagate with SpMV instead of GEMV
+        static const double sparse_density_cutoff = 0.1;
+
+        template<typename Derived>
+        static bool is_mostly_zero(const Eigen::MatrixBase<Derived>& mat){
+            auto nnz = (mat.array() != 0.0).count();
+            return nnz < sparse_density_cutoff * mat.size();
+        }
+
+        /**
+         * @name MarkovChain::distributionAt
+         * @param t: time
+         * @return: 1 x N row vector, _initial * _transition^t
+         */
+        template<typename Scalar>
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::distributionAt(int t) const{
+            /*
+             t vector-matrix products cost t*nnz on the sparse path and t*n^2 on the dense one;
+             squaring costs about 2*log2(t) dense matrix-matrix products, or 2*n^3*log2(t).
+             Only square when that is actually cheaper than the path that would be taken.
+             */
+            double n = numStates;
+            double nnz = (_transition.array() != 0.0).count();
+            bool sparse = nnz < sparse_density_cutoff * _transition.size();
+            double stepCost = sparse ? nnz : n*n;
+            if(t > 1 && t * stepCost > 2.0 * n * n * n * std::log2(double(t))){
+                return distribution_power(_initial, _transition, t);
+            }
+            RowVectorType init = _initial.row(0);
+            RowVectorType res;
+            if(sparse){
+                Eigen::SparseMatrix<Scalar> sp = _transition.sparseView();
+                res = propagate_distribution(init, sp, t);
+            }
+            else{
+                res = propagate_distribution(init, _transition, t);
+            }
+            return res;
+        }
+
+        /**
+         * @name MarkovChain::distributionTrajectory
+         * @param T: last time
+         * @return: (T+1) x N matrix whose row t is the distribution of X_t
+         */
+        template<typename Scalar>
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::distributionTrajectory(int T) const{
+            MatrixType traj(T+1, numStates);
+            distributionTrajectory(T, [&traj](int t, const RowVectorType& dist){
+                traj.row(t) = dist;
+            });
+            return traj;
+        }
+
+        /**
+         * @name MarkovChain::distributionTrajectory
+         * @param T: last time
+         * @param callback: called as callback(t, dist_t) for t = 0, 1, ..., T
+         */
+        template<typename Scalar>
+        void BasicMarkovChain<Scalar>::distributionTrajectory(int T, const std::function<void(int, const RowVectorType&)>& callback) const{
+            RowVectorType init = _initial.row(0);
+            if(is_mostly_zero(_transition)){
+                Eigen::SparseMatrix<Scalar> sp = _transition.sparseView();
+                propagate_distribution(init, sp, T, callback);
+            }
+            else{
+                propagate_distribution(init, _transition, T, callback);
+            }
+        }
+
         /**
          * @summary: does mat contain key?
          * @return: answer to above question, true or false for yes or no
          */
-        bool MarkovChain::contains(const Eigen::MatrixXd& mat, double key) const noexcept{
+        template<typename Scalar>
+        bool BasicMarkovChain<Scalar>::contains(const MatrixType& mat, double key) const noexcept{
             auto n = mat.cols();
             
             if( n < 1 ){ return false;}
@@ -183,8 +285,9 @@ namespace Markov
          * @author: Zane Jakobs
          * @return: matrix of number of paths of length n from state i to state j
          */
-        Eigen::MatrixXd MarkovChain::numPaths(int n) const{
-            Eigen::MatrixXd logicMat(numStates,numStates);
+        template<typename Scalar>
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::numPaths(int n) const{
+            MatrixType logicMat(numStates,numStates);
             for(int i = 0; i< numStates; i++){
                 for(int j = 0; j < numStates; j++){
                     if(_transition(i,j) != 0){
@@ -196,7 +299,7 @@ namespace Markov
                 }//end inner for
             }
             if(n > 1){
-                Eigen::MatrixXd powmat = Markov::matrix_power(logicMat, n);
+                MatrixType powmat = Markov::matrix_power(logicMat, n);
                 return powmat;
             }
             
@@ -208,10 +311,11 @@ namespace Markov
          * @author: Zane Jakobs
          * @return 1 or 0 for if state j can be reached from state i
          */
-    Eigen::MatrixXd MarkovChain::isReachable() const{
-            Eigen::MatrixXd R(numStates,numStates);
-            Eigen::MatrixXd Rcomp = Eigen::MatrixXd::Zero(numStates,numStates);
-            Eigen::MatrixXd temp(numStates, numStates);
+    template<typename Scalar>
+    typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::isReachable() const{
+            MatrixType R(numStates,numStates);
+            MatrixType Rcomp = MatrixType::Zero(numStates,numStates);
+            MatrixType temp(numStates, numStates);
             for(int i = 1; i <= numStates; i++){
                 temp  = matrix_power(_transition, i);
                 Rcomp += temp;
@@ -230,8 +334,9 @@ namespace Markov
             return R;
         }
         
+        template<typename Scalar>
         template<typename T>
-        constexpr bool MarkovChain::isInVec(const std::vector<T>& v, T key){
+        constexpr bool BasicMarkovChain<Scalar>::isInVec(const std::vector<T>& v, T key){
             for(auto it = v.begin(); it != v.end(); it++){
                 if( *it == key){
                     return true;
@@ -243,9 +348,10 @@ namespace Markov
          * @author: Zane Jakobs
          * @return matrix where each row has a 1 in the column of each element in that communicating class (one row = one class)
          */
-        Eigen::MatrixXd MarkovChain::communicatingClasses() const{
-            Eigen::MatrixXd CC(numStates,numStates);
-            Eigen::MatrixXd reachable = isReachable();
+        template<typename Scalar>
+        typename BasicMarkovChain<Scalar>::MatrixType BasicMarkovChain<Scalar>::communicatingClasses() const{
+            MatrixType CC(numStates,numStates);
+            MatrixType reachable = isReachable();
             
             for(int i = 0; i< numStates; i++){
                 for(int j = 0; j < numStates; j++){
@@ -303,7 +409,8 @@ namespace Markov
          * @param s0: initial state
          * @param sh: target state
          */
-        double MarkovChain::expectedHittingTime(int s0, int sh) const{
+        template<typename Scalar>
+        double BasicMarkovChain<Scalar>::expectedHittingTime(int s0, int sh) const{
             /*
              Algorithm: let u_i = E[T|X_0 = i]. Set up system of equations. Solve for u_s0. We have the equation Au = c, where u = (u_0, u_1, ..., u_n)^T, c = (-1,-1,...,0,-1,...-1)^T, with 0 in the spot corresponding to sh, and
              
@@ -342,26 +449,12 @@ namespace Markov
                         }
                     }//end if
                     else{
-                        (j == i) ? (A(i,j) = _transition(i,j)-1) : (A(i,j) == _transition(i,j));
+                        (j == i) ? (A(i,j) = _transition(i,j)-1) : (A(i,j) = _transition(i,j));
                     }
                 }//end inner for
             }//end outer for
             
-            /*choose linear solver based on matrix size. Using info from Eigen docs at
-             https://eigen.tuxfamily.org/dox/group__TutorialLinearAlgebra.html
-             */
-            
-            if(numStates < 500){
-                //for smaller matrices, rank-revealing Householder QR decomposition with column pivoting
-                Eigen::ColPivHouseholderQR<Eigen::MatrixXd> CPH(A);
-                u = CPH.solve(c);
-                
-            }
-            else{
-                //for big ones, use regular Householder QR
-                Eigen::HouseholderQR<Eigen::MatrixXd> HQR(A);
-                u = HQR.solve(c);
-            }
+            u = solve(A, c);
             const double err_tol = 1.0e-4; //error tolerance on solutions
             double relative_error = (A*u - c).norm() / c.norm();
             if(relative_error < err_tol){
@@ -380,7 +473,8 @@ namespace Markov
          * @param sEnd: end state
          * @return: mean time the chain spends in sInt, starting at s0, before returning to s0
          */
-        double MarkovChain::meanTimeInStateBeforeReturn(int s0, int sInt) const{
+        template<typename Scalar>
+        double BasicMarkovChain<Scalar>::meanTimeInStateBeforeReturn(int s0, int sInt) const{
             /*
              Algorithm: We want to solve Aw = c, where c = (0,0,...,-1,0,...,0)^T, with the -1 in the sInt position, and w = (w0, w1, ..., wsInt, ... ,wn)^T. We want ws0. We also define
              
@@ -417,20 +511,7 @@ namespace Markov
                 }//end inner for
             }//end outer for
             
-            /*choose linear solver based on matrix size. Using info from Eigen docs at
-             https://eigen.tuxfamily.org/dox/group__TutorialLinearAlgebra.html
-             */
-            
-            if(numStates < 500){
-                //for smaller matrices, rank-revealing Householder QR decomposition with column pivoting
-                Eigen::ColPivHouseholderQR<Eigen::MatrixXd> CPH(A);
-                w = CPH.solve(c);
-            }
-            else{
-                //for big ones, use regular Householder QR
-                Eigen::HouseholderQR<Eigen::MatrixXd> HQR(A);
-                w = HQR.solve(c);
-            }
+            w = solve(A, c);
             const double err_tol = 1.0e-4; //error tolerance on solutions
             double relative_error = (A*w - c).norm() / c.norm();
             if(relative_error < err_tol){
@@ -448,7 +529,8 @@ namespace Markov
          * @param sEnd: end state
          * @return: mean time the chain spends in sInt, starting at s0, before hitting sEnd
          */
-        double MarkovChain::meanTimeInStateBeforeHit(int s0, int sInt, int sEnd) const{
+        template<typename Scalar>
+        double BasicMarkovChain<Scalar>::meanTimeInStateBeforeHit(int s0, int sInt, int sEnd) const{
             /*
              Algorithm: We want to solve Aw = c, where c = (0,0,...,-1,0,...,0)^T, with the -1 in the sInt position, and w = (w0, w1, ..., wsInt, ... ,wn)^T. We want ws0. We also define
              
@@ -492,21 +574,7 @@ namespace Markov
                 }//else
             }//end outer for
             
-            /*choose linear solver based on matrix size. Using info from Eigen docs at
-             https://eigen.tuxfamily.org/dox/group__TutorialLinearAlgebra.html
-             */
-            
-            if(numStates < 500){
-                //for smaller matrices, rank-revealing Householder QR decomposition with column pivoting
-                Eigen::ColPivHouseholderQR<Eigen::MatrixXd> CPH(A);
-                w = CPH.solve(c);
-            }
-            else{
-                //for big ones, use regular Householder QR
-                Eigen::HouseholderQR<Eigen::MatrixXd> HQR(A);
-                w = HQR.solve(c);
-                
-            }
+            w = solve(A, c);
             const double err_tol = 1.0e-4; //error tolerance on solutions
             double relative_error = (A*w - c).norm() / c.norm();
             if(relative_error < err_tol){
@@ -524,12 +592,13 @@ namespace Markov
          * @param t: time difference
          * @return: cov(X_s,X_{s+t}), taken from HMM for Time Series: an Intro Using R page 18
          */
-        double MarkovChain::cov(int t) const{
+        template<typename Scalar>
+        double BasicMarkovChain<Scalar>::cov(int t) const{
             const auto expon = 15;
-            Eigen::MatrixXd pi = limitingDistribution(expon);
-            Eigen::MatrixXd V = Eigen::MatrixXd::Zero(numStates,numStates);
-            Eigen::MatrixXd vectV(1,numStates);
-            Eigen::MatrixXd cmat;
+            MatrixType pi = limitingDistribution(expon);
+            MatrixType V = MatrixType::Zero(numStates,numStates);
+            MatrixType vectV(1,numStates);
+            MatrixType cmat;
             for(int i = 0; i < numStates; i++){
                 V(i,i) = i;
                 vectV(0,i) = i;
@@ -540,7 +609,7 @@ namespace Markov
             else{
                 cmat = pi * V* (vectV.transpose());
             }
-            Eigen::MatrixXd dv = pi * (vectV.transpose());
+            MatrixType dv = pi * (vectV.transpose());
             
             cmat -= dv*dv;
             //cov is a 1x1 from line 590 onwards;
@@ -553,15 +622,17 @@ namespace Markov
          * @param t: time difference
          * @return: corr(X_s,X_{s+t}), taken from HMM for Time Series: an Intro Using R page 18
          */
-    double MarkovChain::corr(int t) const{
-            auto correlation = MarkovChain::cov(t)/MarkovChain::cov(0);
+    template<typename Scalar>
+    double BasicMarkovChain<Scalar>::corr(int t) const{
+            auto correlation = cov(t)/cov(0);
             return correlation;
         }
     /**
     *@author Zane Jakobs
     *@return log likelihood of the MLE for a given dataset
     */
-    double MarkovChain::log_likelihood(const vector<Sequence>& df, int oversize) const{
+    template<typename Scalar>
+    double BasicMarkovChain<Scalar>::log_likelihood(const vector<Sequence>& df, int oversize) const{
             auto f = MLE(df, oversize);
             double ll = 0.0;
             for(int i = 0; i < numStates; i++){
@@ -573,6 +644,30 @@ namespace Markov
         }
     
     
+    /**
+     * @summary: solves A x = c, with mixed-precision refinement if enabled
+     */
+    template<typename Scalar>
+    Eigen::VectorXd BasicMarkovChain<Scalar>::solve(const Eigen::MatrixXd& A, const Eigen::VectorXd& c) const{
+        if(mixedPrecision){
+            return mixed_precision_solve(A, c);
+        }
+        /*choose linear solver based on matrix size. Using info from Eigen docs at
+         https://eigen.tuxfamily.org/dox/group__TutorialLinearAlgebra.html
+         */
+        if(numStates < 500){
+            //for smaller matrices, rank-revealing Householder QR decomposition with column pivoting
+            Eigen::ColPivHouseholderQR<Eigen::MatrixXd> CPH(A);
+            return CPH.solve(c);
+        }
+        //for big ones, use regular Householder QR
+        Eigen::HouseholderQR<Eigen::MatrixXd> HQR(A);
+        return HQR.solve(c);
+    }
+    
+    template class BasicMarkovChain<double>;
+    template class BasicMarkovChain<float>;
+    
 }//end namespace
 
 #endif
@@ -1,6 +1,4 @@
 
-#ifndef MarkovFunctions_hpp
-#define MarkovFunctions_hpp
 #include<mkl.h>
 #include<vector>
 #ifdef Success
@@ -14,33 +12,18 @@
 #include<typeinfo>
 #include<complex>
 #include<Eigen/LU>
+#include<Eigen/QR>
+#include<Eigen/Sparse>
+#include<Eigen/SparseLU>
 #include<utility>
+#include<limits>
 #include<type_traits>
 #include "../include/MarkovFunctions.h"
+#include "../include/AliasTable.h"
 using namespace std;
 using namespace Eigen;
 namespace Markov
 {
-    /**
-     Taken from Effective Modern C++
-     *@author: Scott Meyers
-     *@param T: type of array
-     *@param N: length of array
-     *@return: length of array
-     */
-    template<typename T, size_t N>
-    constexpr size_t arr_size(T (&)[N]) noexcept
-    {
-        return N;
-    }
-    
-    template<class T, class UnaryOp>
-    constexpr decltype(auto) make_mapply_pair(T obj, UnaryOp fun) noexcept
-    {
-        std::pair<T, UnaryOp> mpair(obj, fun);
-        return mpair;
-    }
-    
     /**
      implementing piping for univariate functions; up here is piping with pass by value (lotsa
      */
@@ -151,25 +134,6 @@ namespace Markov
         return P()(std::forward<T>(x));
     }
     
-    /**
-     * @name MarkovChain::randTransition
-     * @summary: initialRand: generates random state
-     * @param matrix: transition matrix
-     * @param index: current state
-     * @param u: random uniform between 0 and 1
-     * @return index corresponding to the transition we make
-     */
-    constexpr int random_transition(const Eigen::MatrixXd &mat, int nStates, int init_state, double r) noexcept{
-        auto s = mat(init_state,0);
-        int i = 0;
-        while(r > s && (i < nStates)){
-            i++;
-            s += mat(init_state,i);
-        }
-        
-        return i;
-    }
-    
     /**
      * Taken from https://software.intel.com/en-us/node/521147
      * @summary: C++ declaration of FORTRAN function dgeev
@@ -283,6 +247,12 @@ namespace Markov
         }
         return mat;
     }
+    Eigen::MatrixXf normalize_rows(Eigen::MatrixXf &mat){
+        for(int i = 0; i < mat.rows(); i++){
+            mat.row(i) = mat.row(i)/(mat.row(i).sum());
+        }
+        return mat;
+    }
     /**
      *@author: Zane Jakobs
      *@param mat: matrix to raise to power, passed by value for safe use with class members
@@ -309,6 +279,46 @@ namespace Markov
         }
     }
     
+    Eigen::MatrixXf matrix_power(const Eigen::MatrixXf& mat, const int& expon){
+        Eigen::MatrixXd dmat = mat.cast<double>();
+        return matrix_power(dmat, expon).cast<float>();
+    }
+    
+    /**
+     *@param A: N x N matrix
+     *@param b: right-hand side
+     *@param tol: relative residual tolerance
+     *@param maxIter: maximum number of refinement steps
+     *@return: x
+     */
+    Eigen::VectorXd mixed_precision_solve(const Eigen::MatrixXd& A, const Eigen::VectorXd& b, double tol, int maxIter){
+        Eigen::MatrixXf Af = A.cast<float>();
+        Eigen::PartialPivLU<Eigen::MatrixXf> LU(Af);
+        Eigen::VectorXd x = LU.solve(b.cast<float>()).cast<double>();
+        double bnorm = b.norm();
+        if(bnorm == 0){
+            return x;
+        }
+        Eigen::VectorXd r(b.size());
+        double last = std::numeric_limits<double>::infinity();
+        for(int k = 0; k < maxIter; k++){
+            //residual in double is what buys back the accuracy
+            r.noalias() = b - A * x;
+            double rnorm = r.norm();
+            if(rnorm <= tol * bnorm){
+                return x;
+            }
+            //refinement only contracts if the float factorization is good enough
+            if(!(rnorm < 0.5 * last)){
+                break;
+            }
+            last = rnorm;
+            x += LU.solve(r.cast<float>()).cast<double>();
+        }
+        Eigen::PartialPivLU<Eigen::MatrixXd> LUd(A);
+        return LUd.solve(b);
+    }
+    
     /**
      * @author: Zane Jakobs
      * @param M: type of thing we're taking the polynomial of--specialized for
@@ -374,41 +384,100 @@ namespace Markov
     }
     
     /**
-     * @name MarkovChain::generate_mc_sequence
-     * @summary: generateSequence generates a sequence of length n from the Markov chain
-     * @param n: length of sequence
-     * @param matT: transition matrix
-     * @param initialDist: initial distribution
-     * @return: vector of ints representing the sequence
+     * @param weights: nonnegative weights, need not sum to 1
+     * @param n: number of weights
+     * @source: Vose, "A linear algorithm for generating random numbers with a given distribution"
      */
-    vector<int> generate_mc_sequence(int n, const Eigen::MatrixXd& matT, const Eigen::MatrixXd& initialDist) noexcept{
-        unsigned numStates = matT.cols();
-        std::vector<int> sequence(n);
-        int i = 0;
-        int id = 0;
-        double randNum;
-        //set random seed
-        random_device rd;
-        //init Mersenne Twistor
-        mt19937 gen(rd());
-        // unif(0,1)
-        uniform_real_distribution<> dis(0.0,1.0);
-        
-        randNum = dis(gen);
-        //initial state chosen by random transition from state 0 according to
-        //initial distribution
-        auto init = random_transition(initialDist,numStates, 0, randNum);
-        sequence[i] = init;
-        id = init;
-        
-        
-        for(i = 1; i<n; i++){
-            randNum = dis(gen);
-            id = random_transition(matT,numStates, id, randNum);
-            sequence[i] = id;
+    AliasTable::AliasTable(const double* weights, int n) : prob(n, 0.0), alias(n, 0){
+        double total = 0;
+        for(int i = 0; i < n; i++){
+            total += weights[i];
+        }
+        std::vector<int> small, large;
+        small.reserve(n);
+        large.reserve(n);
+        for(int i = 0; i < n; i++){
+            prob[i] = weights[i] * n / total;
+            alias[i] = i;
+            (prob[i] < 1.0) ? small.push_back(i) : large.push_back(i);
+        }
+        while(!small.empty() && !large.empty()){
+            int s = small.back();
+            small.pop_back();
+            int l = large.back();
+            alias[s] = l;
+            prob[l] -= (1.0 - prob[s]);
+            if(prob[l] < 1.0){
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        //anything left over is 1 up to rounding
+        for(auto i : small){
+            prob[i] = 1.0;
+        }
+        for(auto i : large){
+            prob[i] = 1.0;
         }
-        return sequence;
-        
     }
+    
+    /**
+     * @param Q: N x N generator matrix (rows sum to 0)
+     * @param mixedPrecision: use mixed-precision refinement
+     * @return: 1 x N stationary distribution
+     */
+    Eigen::MatrixXd stationary_from_generator(const Eigen::MatrixXd& Q, bool mixedPrecision){
+        /*
+         pi * Q = 0 is Q^T pi^T = 0, which has rank N-1 for an irreducible chain, so we
+         replace the last equation with sum(pi) = 1
+         */
+        auto n = Q.cols();
+        Eigen::MatrixXd A = Q.transpose();
+        A.row(n-1).setOnes();
+        Eigen::VectorXd b = Eigen::VectorXd::Zero(n);
+        b(n-1) = 1.0;
+        Eigen::VectorXd pi;
+        if(mixedPrecision){
+            pi = mixed_precision_solve(A, b);
+        }
+        else if(n < 500){
+            Eigen::ColPivHouseholderQR<Eigen::MatrixXd> CPH(A);
+            pi = CPH.solve(b);
+        }
+        else{
+            Eigen::PartialPivLU<Eigen::MatrixXd> LU(A);
+            pi = LU.solve(b);
+        }
+        return pi.transpose();
+    }
+    
+    Eigen::MatrixXd stationary_from_generator(const Eigen::SparseMatrix<double>& Q){
+        auto n = Q.cols();
+        std::vector<Eigen::Triplet<double> > trips;
+        trips.reserve(Q.nonZeros() + n);
+        for(int k = 0; k < Q.outerSize(); k++){
+            for(Eigen::SparseMatrix<double>::InnerIterator it(Q, k); it; ++it){
+                //transpose, and drop the last equation
+                if(it.col() != n-1){
+                    trips.emplace_back(it.col(), it.row(), it.value());
+                }
+            }
+        }
+        for(int j = 0; j < n; j++){
+            trips.emplace_back(n-1, j, 1.0);
+        }
+        Eigen::SparseMatrix<double> A(n, n);
+        A.setFromTriplets(trips.begin(), trips.end());
+        Eigen::VectorXd b = Eigen::VectorXd::Zero(n);
+        b(n-1) = 1.0;
+        Eigen::SparseLU<Eigen::SparseMatrix<double> > LU;
+        LU.analyzePattern(A);
+        LU.factorize(A);
+        if(LU.info() != Eigen::Success){
+            throw "Error: sparse LU factorization of the generator failed.";
+        }
+        Eigen::VectorXd pi = LU.solve(b);
+        return pi.transpose();
+    }
+    
 }
-#endif /* MarkovFunctions_hpp */
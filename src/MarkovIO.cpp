@@ -0,0 +1,341 @@
+/**
+ * @summary : binary serialization of Markov chains, and mmap-based loading.
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+#ifdef Success
+#undef Success
+#endif
+#include"../include/MarkovIO.h"
+#include"../include/AliasTable.h"
+#include"../include/MarkovFunctions.h"
+#include<Eigen/Core>
+#include<Eigen/Sparse>
+#include<mkl.h>
+#include<fstream>
+#include<vector>
+#include<cstring>
+#include<utility>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    static const char markov_file_magic[8] = {'M','A','R','K','O','V','C','\0'};
+    static const uint64_t section_alignment = 64;
+
+    static uint64_t align_up(uint64_t x){
+        return (x + section_alignment - 1) & ~(section_alignment - 1);
+    }
+
+    //pads the stream with zeros up to offset, then writes len bytes
+    static void write_section(std::ofstream& out, uint64_t offset, const void* data, size_t len){
+        static const char zeros[section_alignment] = {0};
+        uint64_t pos = out.tellp();
+        while(pos < offset){
+            auto pad = std::min<uint64_t>(offset - pos, section_alignment);
+            out.write(zeros, pad);
+            pos += pad;
+        }
+        out.write(static_cast<const char*>(data), len);
+    }
+
+    /*
+     lays out sections after the header; the alias and stationary sections are only given
+     offsets if requested
+     */
+    static MarkovFileHeader make_header(uint64_t n, uint64_t nnz, uint32_t flags){
+        MarkovFileHeader h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, markov_file_magic, sizeof(h.magic));
+        h.version = markov_file_version;
+        h.flags = flags;
+        h.numStates = n;
+        h.nnz = nnz;
+        //end of the last section written so far; each new section starts at the next boundary
+        uint64_t end = sizeof(MarkovFileHeader);
+        auto place = [&end](uint64_t bytes){
+            uint64_t offset = align_up(end);
+            end = offset + bytes;
+            return offset;
+        };
+        h.valuesOffset = place(nnz * sizeof(double));
+        if(flags & MARKOV_FILE_SPARSE){
+            h.innerOffset = place(nnz * sizeof(int32_t));
+            h.outerOffset = place((n+1) * sizeof(int32_t));
+        }
+        h.initialOffset = place(n * sizeof(double));
+        if(flags & MARKOV_FILE_ALIAS){
+            h.aliasProbOffset = place(nnz * sizeof(double));
+            h.aliasIndexOffset = place(nnz * sizeof(int32_t));
+        }
+        if(flags & MARKOV_FILE_STATIONARY){
+            h.stationaryOffset = place(n * sizeof(double));
+        }
+        h.fileSize = end;
+        return h;
+    }
+
+    static void write_tail(std::ofstream& out, const MarkovFileHeader& h, const Eigen::RowVectorXd& init,
+                           const std::vector<double>& aliasProb, const std::vector<int32_t>& aliasIndex,
+                           const Eigen::RowVectorXd& stationary){
+        write_section(out, h.initialOffset, init.data(), h.numStates * sizeof(double));
+        if(h.aliasProbOffset){
+            write_section(out, h.aliasProbOffset, aliasProb.data(), aliasProb.size() * sizeof(double));
+            write_section(out, h.aliasIndexOffset, aliasIndex.data(), aliasIndex.size() * sizeof(int32_t));
+        }
+        if(h.stationaryOffset){
+            write_section(out, h.stationaryOffset, stationary.data(), h.numStates * sizeof(double));
+        }
+        if(!out){
+            throw "Error: failed to write Markov chain file.";
+        }
+    }
+
+    /**
+     * @param path: file to write
+     * @param mc: chain to write
+     * @param flags: bitwise or of MarkovFileFlags
+     */
+    void save_markov_chain(const std::string& path, const MarkovChain& mc, uint32_t flags){
+        if(flags & MARKOV_FILE_SPARSE){
+            Eigen::MatrixXd dense = mc.getTransition();
+            Eigen::SparseMatrix<double, Eigen::RowMajor> sp = dense.sparseView();
+            save_markov_chain(path, sp, mc.getInit(), flags);
+            return;
+        }
+        Eigen::MatrixXd trans = mc.getTransition();
+        uint64_t n = trans.cols();
+        MarkovFileHeader h = make_header(n, n*n, flags);
+
+        std::vector<double> aliasProb;
+        std::vector<int32_t> aliasIndex;
+        if(flags & MARKOV_FILE_ALIAS){
+            aliasProb.reserve(n*n);
+            aliasIndex.reserve(n*n);
+            std::vector<double> row(n);
+            for(uint64_t i = 0; i < n; i++){
+                for(uint64_t j = 0; j < n; j++){
+                    row[j] = trans(i,j);
+                }
+                AliasTable table(row.data(), n);
+                aliasProb.insert(aliasProb.end(), table.prob.begin(), table.prob.end());
+                aliasIndex.insert(aliasIndex.end(), table.alias.begin(), table.alias.end());
+            }
+        }
+        Eigen::RowVectorXd stationary;
+        if(flags & MARKOV_FILE_STATIONARY){
+            stationary = mc.stationaryDistribution().row(0);
+        }
+        Eigen::RowVectorXd init = mc.getInit().row(0);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if(!out){
+            throw "Error: could not open Markov chain file for writing.";
+        }
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        write_section(out, h.valuesOffset, trans.data(), n*n*sizeof(double));
+        write_tail(out, h, init, aliasProb, aliasIndex, stationary);
+    }
+
+    /**
+     * @param path: file to write
+     * @param trans: N x N transition matrix
+     * @param initial: 1 x N initial distribution
+     * @param flags: bitwise or of MarkovFileFlags
+     */
+    void save_markov_chain(const std::string& path, const Eigen::SparseMatrix<double, Eigen::RowMajor>& trans,
+                           const Eigen::MatrixXd& initial, uint32_t flags){
+        flags |= MARKOV_FILE_SPARSE;
+        Eigen::SparseMatrix<double, Eigen::RowMajor, int32_t> P = trans;
+        P.makeCompressed();
+        uint64_t n = P.cols();
+        uint64_t nnz = P.nonZeros();
+        MarkovFileHeader h = make_header(n, nnz, flags);
+
+        std::vector<double> aliasProb;
+        std::vector<int32_t> aliasIndex;
+        if(flags & MARKOV_FILE_ALIAS){
+            aliasProb.reserve(nnz);
+            aliasIndex.reserve(nnz);
+            for(uint64_t i = 0; i < n; i++){
+                int begin = P.outerIndexPtr()[i];
+                int len = P.outerIndexPtr()[i+1] - begin;
+                if(len == 0){
+                    continue;
+                }
+                AliasTable table(P.valuePtr() + begin, len);
+                aliasProb.insert(aliasProb.end(), table.prob.begin(), table.prob.end());
+                aliasIndex.insert(aliasIndex.end(), table.alias.begin(), table.alias.end());
+            }
+        }
+        Eigen::RowVectorXd stationary;
+        if(flags & MARKOV_FILE_STATIONARY){
+            Eigen::SparseMatrix<double> Q = P;
+            for(uint64_t i = 0; i < n; i++){
+                Q.coeffRef(i,i) -= 1.0;
+            }
+            stationary = stationary_from_generator(Q).row(0);
+        }
+        Eigen::RowVectorXd init = initial.row(0);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if(!out){
+            throw "Error: could not open Markov chain file for writing.";
+        }
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        write_section(out, h.valuesOffset, P.valuePtr(), nnz*sizeof(double));
+        write_section(out, h.innerOffset, P.innerIndexPtr(), nnz*sizeof(int32_t));
+        write_section(out, h.outerOffset, P.outerIndexPtr(), (n+1)*sizeof(int32_t));
+        write_tail(out, h, init, aliasProb, aliasIndex, stationary);
+    }
+
+    MappedMarkovChain::MappedMarkovChain(const std::string& path){
+        open(path);
+    }
+
+    MappedMarkovChain::~MappedMarkovChain(){
+        close();
+    }
+
+    MappedMarkovChain::MappedMarkovChain(MappedMarkovChain&& other) noexcept
+        : _base(other._base), _size(other._size), _header(other._header){
+        other._base = nullptr;
+        other._size = 0;
+        other._header = nullptr;
+    }
+
+    MappedMarkovChain& MappedMarkovChain::operator=(MappedMarkovChain&& other) noexcept{
+        if(this != &other){
+            close();
+            std::swap(_base, other._base);
+            std::swap(_size, other._size);
+            std::swap(_header, other._header);
+        }
+        return *this;
+    }
+
+    /**
+     * @summary: maps path read-only and checks the header. Nothing else is read, so the
+     * pages are only faulted in as they are used
+     */
+    void MappedMarkovChain::open(const std::string& path){
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            throw "Error: could not open Markov chain file.";
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(MarkovFileHeader))){
+            ::close(fd);
+            throw "Error: Markov chain file is truncated.";
+        }
+        void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        //the mapping keeps the file alive, so the descriptor is not needed anymore
+        ::close(fd);
+        if(base == MAP_FAILED){
+            throw "Error: could not map Markov chain file.";
+        }
+        _base = base;
+        _size = st.st_size;
+        auto h = static_cast<const MarkovFileHeader*>(base);
+        if(std::memcmp(h->magic, markov_file_magic, sizeof(h->magic)) != 0){
+            close();
+            throw "Error: not a Markov chain file.";
+        }
+        if(h->version != markov_file_version){
+            close();
+            throw "Error: unsupported Markov chain file version.";
+        }
+        if(h->fileSize > _size){
+            close();
+            throw "Error: Markov chain file is truncated.";
+        }
+        _header = h;
+    }
+
+    void MappedMarkovChain::close() noexcept{
+        if(_base){
+            munmap(_base, _size);
+        }
+        _base = nullptr;
+        _size = 0;
+        _header = nullptr;
+    }
+
+    Eigen::Map<const Eigen::MatrixXd> MappedMarkovChain::denseTransition() const{
+        int n = getNumStates();
+        return Eigen::Map<const Eigen::MatrixXd>(section<double>(_header->valuesOffset), n, n);
+    }
+
+    Eigen::Map<const Eigen::SparseMatrix<double, Eigen::RowMajor, int> > MappedMarkovChain::sparseTransition() const{
+        int n = getNumStates();
+        return Eigen::Map<const Eigen::SparseMatrix<double, Eigen::RowMajor, int> >(n, n, _header->nnz,
+                    section<int>(_header->outerOffset), section<int>(_header->innerOffset),
+                    section<double>(_header->valuesOffset));
+    }
+
+    Eigen::Map<const Eigen::RowVectorXd> MappedMarkovChain::initial() const{
+        return Eigen::Map<const Eigen::RowVectorXd>(section<double>(_header->initialOffset), getNumStates());
+    }
+
+    Eigen::Map<const Eigen::RowVectorXd> MappedMarkovChain::stationary() const{
+        return Eigen::Map<const Eigen::RowVectorXd>(section<double>(_header->stationaryOffset), getNumStates());
+    }
+
+    /**
+     * @param state: current state
+     * @param u: random uniform between 0 and 1
+     * @return: next state
+     */
+    int MappedMarkovChain::sampleTransition(int state, double u) const noexcept{
+        const double* prob = section<double>(_header->aliasProbOffset);
+        const int32_t* alias = section<int32_t>(_header->aliasIndexOffset);
+        int64_t begin;
+        int len;
+        if(isSparse()){
+            const int32_t* outer = section<int32_t>(_header->outerOffset);
+            begin = outer[state];
+            len = outer[state+1] - outer[state];
+            if(len == 0){
+                //a row with no stored mass has nothing to sample from; treat it as absorbing
+                return state;
+            }
+        }
+        else{
+            len = getNumStates();
+            begin = static_cast<int64_t>(state) * len;
+        }
+        double scaled = u * len;
+        int k = static_cast<int>(scaled);
+        if(k >= len){
+            k = len - 1;
+        }
+        if(scaled - k >= prob[begin + k]){
+            k = alias[begin + k];
+        }
+        return isSparse() ? section<int32_t>(_header->innerOffset)[begin + k] : k;
+    }
+
+    MarkovChain MappedMarkovChain::toMarkovChain() const{
+        int n = getNumStates();
+        Eigen::MatrixXd trans;
+        if(isSparse()){
+            trans = Eigen::MatrixXd(sparseTransition());
+        }
+        else{
+            trans = denseTransition();
+        }
+        Eigen::MatrixXd init = initial();
+        return MarkovChain(trans, init, n);
+    }
+
+    MarkovChain load_markov_chain(const std::string& path){
+        MappedMarkovChain mapped(path);
+        return mapped.toMarkovChain();
+    }
+}
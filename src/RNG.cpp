@@ -0,0 +1,75 @@
+/**
+ * @summary : implementation of the random number context.
+ * Note that any individual functions not written by the author here have source links in the comments above the declaration
+ */
+#include"../include/RNG.h"
+#include<random>
+#include<chrono>
+#include<cstdint>
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    namespace
+    {
+        uint64_t entropy_seed() noexcept
+        {
+            try{
+                random_device rd;
+                return (static_cast<uint64_t>(rd()) << 32) | rd();
+            } catch(...){
+                //no entropy source; the clock still differs between runs
+                return static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+            }
+        }
+    }
+
+    void RNG::seed(uint64_t seed) noexcept{
+        uint64_t x = seed;
+        for(auto& w : s){
+            w = splitmix64(x);
+        }
+    }
+
+    void RNG::seed(uint64_t seed, uint64_t stream) noexcept{
+        //s[0] is a bijection of seed and, for a fixed seed, s[2] is a bijection of stream
+        //(the multiplier is odd), so distinct (seed, stream) pairs always give distinct states;
+        //in particular (a, b) and (b, a) differ, and so do the streams of consecutive seeds
+        uint64_t x = seed;
+        s[0] = splitmix64(x);
+        s[1] = splitmix64(x);
+        uint64_t y = s[1] ^ (stream * 0x9e3779b97f4a7c15ULL);
+        s[2] = splitmix64(y);
+        s[3] = splitmix64(y);
+    }
+
+    /**
+     * @source: Blackman and Vigna, http://prng.di.unimi.it/xoshiro256plusplus.c
+     */
+    void RNG::jump() noexcept{
+        static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        uint64_t t[4] = {0, 0, 0, 0};
+        for(auto word : JUMP){
+            for(int b = 0; b < 64; b++){
+                if(word & (UINT64_C(1) << b)){
+                    for(int i = 0; i < 4; i++){
+                        t[i] ^= s[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        for(int i = 0; i < 4; i++){
+            s[i] = t[i];
+        }
+    }
+
+    RNG& default_rng() noexcept{
+        thread_local RNG rng(entropy_seed());
+        return rng;
+    }
+
+    void seed_default_rng(uint64_t seed) noexcept{
+        default_rng().seed(seed);
+    }
+}
@@ -0,0 +1,131 @@
+/**
+ * @summary : implementation of the per-row sampling tables.
+ * Note that any individual functions not written by the author here have source links in the comments above the declaration
+ */
+#ifndef EIGEN_USE_MKL_ALL
+#define EIGEN_USE_MKL_ALL
+#endif
+#ifdef Success
+#undef Success
+#endif
+#include"../include/TransitionSampler.h"
+#include<vector>
+#include<utility>
+#include<algorithm>
+#include<cmath>
+#include<Eigen/Core>
+#include<Eigen/Sparse>
+#include<mkl.h>
+#include"../include/AliasTable.h"
+using namespace std;
+using namespace Markov;
+namespace Markov
+{
+    double row_entropy(const double* p, int n) noexcept{
+        double total = 0;
+        for(int i = 0; i < n; i++){
+            total += p[i];
+        }
+        double H = 0;
+        for(int i = 0; i < n; i++){
+            if(p[i] > 0){
+                double q = p[i]/total;
+                H -= q * std::log2(q);
+            }
+        }
+        return H;
+    }
+
+    /**
+     * @param row: row being added; rows must be added in order
+     * @param begin, end: range of (probability, column) pairs, nonzeros only
+     */
+    template<typename RowIterator>
+    void TransitionSampler::addRow(int row, RowIterator begin, RowIterator end, RowLayout layout, double entropyCutoff){
+        std::vector<std::pair<double,int> > entries(begin, end);
+        if(entries.empty()){
+            throw "Error: transition matrix has a row with no nonzero entries.";
+        }
+        //descending probability; ties by column so the layout is deterministic
+        std::sort(entries.begin(), entries.end(), [](const std::pair<double,int>& a, const std::pair<double,int>& b){
+            return (a.first > b.first) || (a.first == b.first && a.second < b.second);
+        });
+        int k = entries.size();
+        std::vector<double> p(k);
+        for(int j = 0; j < k; j++){
+            p[j] = entries[j].first;
+            _index.push_back(entries[j].second);
+        }
+        bool alias = (layout == ROW_ALIAS) || (layout == ROW_ADAPTIVE && row_entropy(p.data(), k) > entropyCutoff);
+        _useAlias[row] = alias;
+        if(alias){
+            AliasTable table(p.data(), k);
+            _value.insert(_value.end(), table.prob.begin(), table.prob.end());
+            _alias.insert(_alias.end(), table.alias.begin(), table.alias.end());
+        }
+        else{
+            double total = 0;
+            for(auto x : p){
+                total += x;
+            }
+            double s = 0;
+            for(auto x : p){
+                s += x;
+                _value.push_back(s/total);
+                _alias.push_back(0);
+            }
+        }
+        _offsets[row+1] = _index.size();
+    }
+
+    TransitionSampler::TransitionSampler(const Eigen::MatrixXd& transition, RowLayout layout, double entropyCutoff){
+        numStates = transition.rows();
+        _offsets.assign(numStates + 1, 0);
+        _useAlias.assign(numStates, 0);
+        std::vector<std::pair<double,int> > entries;
+        for(int i = 0; i < numStates; i++){
+            entries.clear();
+            for(int j = 0; j < transition.cols(); j++){
+                if(transition(i,j) > 0){
+                    entries.emplace_back(transition(i,j), j);
+                }
+            }
+            addRow(i, entries.begin(), entries.end(), layout, entropyCutoff);
+        }
+    }
+
+    TransitionSampler::TransitionSampler(const Eigen::SparseMatrix<double, Eigen::RowMajor>& transition, RowLayout layout, double entropyCutoff){
+        numStates = transition.rows();
+        _offsets.assign(numStates + 1, 0);
+        _useAlias.assign(numStates, 0);
+        _index.reserve(transition.nonZeros());
+        _value.reserve(transition.nonZeros());
+        _alias.reserve(transition.nonZeros());
+        std::vector<std::pair<double,int> > entries;
+        for(int i = 0; i < numStates; i++){
+            entries.clear();
+            for(Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(transition, i); it; ++it){
+                if(it.value() > 0){
+                    entries.emplace_back(it.value(), it.col());
+                }
+            }
+            addRow(i, entries.begin(), entries.end(), layout, entropyCutoff);
+        }
+    }
+
+    TransitionSampler::TransitionSampler(const MarkovChain& mc, RowLayout layout, double entropyCutoff) : TransitionSampler(mc.getTransition(), layout, entropyCutoff) {}
+
+    double TransitionSampler::expectedCost(int state) const noexcept{
+        if(_useAlias[state]){
+            return 1.0;
+        }
+        //entry j (0-based) is reached with probability 1 - cum[j-1] and read once
+        double cost = 0;
+        double prev = 0;
+        for(int j = _offsets[state]; j < _offsets[state+1]; j++){
+            cost += 1.0 - prev;
+            prev = _value[j];
+        }
+        return cost;
+    }
+}